@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mmgl/mmgl.h"
+
+using namespace mmgl;
+
+static const char *const OBJ_FILE = "equivalence.obj";
+
+static const int CROWD_NUM = 30000;
+
+static int failures = 0;
+
+/**
+ * A bumpy grid of 16x16 quads, two triangles each, sharing their vertices.
+ */
+static void write_obj(const std::string &file) {
+    const int n = 16;
+    std::ofstream out(file);
+    for (int j = 0; j <= n; ++j) {
+        for (int i = 0; i <= n; ++i) {
+            float x = i - n / 2.0f, z = j - n / 2.0f;
+            out << "v " << x * .5f << " " << .4f * std::sin(x) * std::cos(z) << " " << z * .5f << "\n";
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            int v = j * (n + 1) + i + 1;
+            out << "f " << v << " " << v + 1 << " " << v + n + 1 << "\n";
+            out << "f " << v + 1 << " " << v + n + 2 << " " << v + n + 1 << "\n";
+        }
+    }
+}
+
+/**
+ * The surfaces moved between frames by the refit check and queried directly by the occlusion check.
+ */
+struct Movable {
+    std::vector<Sphere *> spheres;
+    std::vector<Point> centers;
+    Triangle *triangle;
+    TriangleMesh *mesh;
+    Instance *instance;
+};
+
+static void place(Movable &movable, float shift) {
+    for (size_t i = 0; i < movable.spheres.size(); ++i) {
+        const Point &c = movable.centers[i];
+        movable.spheres[i]->at(c.x() + shift * std::sin(i * 1.7f), c.y() + shift * .3f, c.z() + shift * std::cos(i));
+    }
+    movable.triangle->point_one(-3 + shift, 2.5f, -7).point_two(-1, 3.5f + shift, -8).point_three(-2, 1, -6 - shift);
+    movable.instance->transform(Transform{}.scale(.5f, .5f, .5f).rotate(30 + 40 * shift, 0, 1, 0)
+                                         .translate(3 - shift, .5f, -7));
+}
+
+static Movable build(Scene &scene) {
+    Movable movable;
+    std::mt19937 generator(4998);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    scene.camera().at(0, 3, 8).facing(0, -.3f, -1).focal_length(10).view_range(12, 9).image_size(128, 96);
+    scene.pointLight().at(10, 20, 10).in(1, 1, 1);
+    scene.ambientLight().in(.05f, .05f, .05f);
+
+    scene.plane(0, 1, 0, -2, Material{.5f, .5f, .5f, 0, 0, 0, .2f, .2f, .2f});
+    for (int i = 0; i < 40; ++i) {
+        Material material{unit(generator), unit(generator), unit(generator), .8f, .8f, .8f,
+                          i % 3 ? 0 : .4f, i % 3 ? 0 : .4f, i % 3 ? 0 : .4f, 50};
+        movable.centers.push_back(Point{unit(generator) * 14 - 7, unit(generator) * 4 - 1.5f, -unit(generator) * 14});
+        movable.spheres.push_back(&scene.sphere(0, 0, 0, .2f + .6f * unit(generator), material));
+    }
+    for (int i = 0; i < 20; ++i) {
+        float x = unit(generator) * 14 - 7, y = unit(generator) * 4 - 1.5f, z = -unit(generator) * 14;
+        float a = unit(generator), b = unit(generator), c = unit(generator), d = unit(generator);
+        scene.triangle(x, y, z, x + a, y + b, z, x, y + c, z - d, Material{.9f, .6f, .2f});
+    }
+    movable.triangle = &scene.triangle();
+    // large slanted triangles overlap many others, so BVH::SBVH makes spatial splits
+    scene.triangle(-8, -2, -15, 8, -2, -12, 0, 6, -16, Material{.6f, .6f, .9f});
+    scene.triangle(-7, -1.5f, -1, 7, 3, -13, -6, 3, -12, Material{.9f, .9f, .6f, 0, 0, 0, .3f, .3f, .3f});
+
+    movable.mesh = &scene.triangle_mesh(OBJ_FILE, Material{.3f, .7f, .4f, .5f, .5f, .5f, 0, 0, 0, 20});
+    const Mesh &mesh = scene.mesh(OBJ_FILE);
+    scene.instance(mesh, Transform{}.scale(.4f, .4f, .4f).rotate(-20, 0, 1, 0).translate(-4, 1.5f, -3),
+                   Material{.8f, .3f, .8f});
+    movable.instance = &scene.instance(mesh, Transform{}, Material{.2f, .5f, .9f, .5f, .5f, .5f, .3f, .3f, .3f, 20});
+    place(movable, 0);
+    return movable;
+}
+
+/**
+ * The reference setup: brute force, single rays, the thread pool and horizontal strips.
+ */
+static void reference_config(SceneConfig &config) {
+    config.render_flag(Render::NORMAL).packet_tracing(false).pixel_sampling_num(1).recursive_limit(3)
+          .thread_num(4).parallel_method(ParallelMethod::THREAD_POOL).tile_order(TileOrder::LINEAR)
+          .logging(false);
+}
+
+/**
+ * Render the scene with tweak applied on top of the reference setup. The surfaces are moved by shift, after a first frame without if refit is set.
+ * The stats of the BVH are stored in bvh_stats if given.
+ */
+static Image render(const std::function<void(SceneConfig &)> &tweak, float shift = 0, bool refit = false,
+                    BVHStats *bvh_stats = nullptr) {
+    Scene scene;
+    Movable movable = build(scene);
+    reference_config(scene.config());
+    if (tweak) {
+        tweak(scene.config());
+    }
+    if (refit) {
+        scene.render();
+    }
+    place(movable, shift);
+    scene.render();
+    if (bvh_stats) {
+        *bvh_stats = scene.bvh_stats();
+    }
+    return scene.camera().image();
+}
+
+/**
+ * Render CROWD_NUM small random spheres through the SAH BVH, enough for the builder to run subtrees as tasks
+ * that submit tasks of their own. The stats of the BVH are stored in bvh_stats if given.
+ */
+static Image render_crowd(const std::function<void(SceneConfig &)> &tweak, BVHStats *bvh_stats = nullptr) {
+    Scene scene;
+    std::mt19937 generator(4998);
+    std::uniform_real_distribution<float> unit(0, 1);
+    scene.camera().at(0, 0, 8).facing(0, 0, -1).focal_length(10).view_range(12, 9).image_size(128, 96);
+    scene.pointLight().at(10, 20, 10).in(1, 1, 1);
+    for (int i = 0; i < CROWD_NUM; ++i) {
+        scene.sphere(unit(generator) * 20 - 10, unit(generator) * 16 - 8, -unit(generator) * 20, .05f,
+                     Material{unit(generator), unit(generator), unit(generator)});
+    }
+    scene.config().render_flag(Render::BVH).bvh_mode(BVH::SAH).pixel_sampling_num(1).recursive_limit(1)
+            .thread_num(4).parallel_method(ParallelMethod::THREAD_POOL).logging(false);
+    if (tweak) {
+        tweak(scene.config());
+    }
+    scene.render();
+    if (bvh_stats) {
+        *bvh_stats = scene.bvh_stats();
+    }
+    return scene.camera().image();
+}
+
+/**
+ * Compare the occlusion queries of a surface, one primitive at a time and as one batch, to the default
+ * Surface::occluded, which runs a closest-hit query on a copy of the ray. The random rays cross the box of
+ * the surface, some start on one of its first start_num primitives.
+ */
+static void check_occluded(const Surface &surface, uint32_t start_num, const std::string &what) {
+    std::mt19937 generator(4998);
+    std::uniform_real_distribution<float> unit(0, 1);
+    const Point &lo = surface.box().min(), &hi = surface.box().max();
+    auto around = [&](float scale) {
+        return Point{(lo.x() + hi.x()) / 2 + (unit(generator) - .5f) * (hi.x() - lo.x()) * scale,
+                     (lo.y() + hi.y()) / 2 + (unit(generator) - .5f) * (hi.y() - lo.y()) * scale,
+                     (lo.z() + hi.z()) / 2 + (unit(generator) - .5f) * (hi.z() - lo.z()) * scale};
+    };
+    std::vector<uint32_t> prims;
+    for (uint32_t prim = 0; prim < surface.prim_num(); ++prim) {
+        prims.push_back(prim);
+    }
+
+    int differ = 0;
+    for (Render flag : {Render::BVH, Render::BVH_BBOX_ONLY}) {
+        for (int i = 0; i < 2000; ++i) {
+            Point from = around(3), to = around(1);
+            Ray ray{from, Vector{to.x() - from.x(), to.y() - from.y(), to.z() - from.z()}};
+            if (i % 4 == 0) {
+                ray.start_at(&surface, static_cast<uint32_t>(generator() % start_num));
+            }
+            float t_max = 2 * unit(generator);
+            bool blocked = false;
+            for (uint32_t prim : prims) {
+                bool expected = surface.Surface::occluded(ray, flag, prim, t_max);
+                differ += surface.occluded(ray, flag, prim, t_max) != expected;
+                blocked = blocked || expected;
+            }
+            differ += surface.occluded_batch(ray, flag, prims.data(), surface.prim_num(), t_max) != blocked;
+        }
+    }
+    if (differ) {
+        std::cout << "FAIL " << what << ": " << differ << " queries differ" << std::endl;
+        ++failures;
+    } else {
+        std::cout << "ok   " << what << std::endl;
+    }
+}
+
+/**
+ * Build the tree over the boxes of CROWD_NUM random spheres and a few long slivers serially and on a pool
+ * of 8 threads, for every builder. The nodes and the primitive order have to be identical.
+ */
+static void check_parallel_build() {
+    std::mt19937 generator(4998);
+    std::uniform_real_distribution<float> unit(0, 1);
+    std::vector<BBox> boxes;
+    for (int i = 0; i < CROWD_NUM; ++i) {
+        float x = unit(generator) * 20 - 10, y = unit(generator) * 16 - 8, z = -unit(generator) * 20;
+        float r = .02f + .1f * unit(generator);
+        boxes.push_back(BBox{x - r, y - r, z - r, x + r, y + r, z + r});
+    }
+    for (int i = 0; i < 64; ++i) {
+        // spans most of the scene, so BVH::SBVH splits it spatially
+        float y = unit(generator) * 16 - 8, z = -unit(generator) * 20;
+        boxes.push_back(BBox{-10, y, z, 10, y + .1f, z + .1f});
+    }
+
+    const std::vector<std::pair<BVH, std::string>> builders{
+            {BVH::VOLUME_CUT, "volume cut"}, {BVH::COUNT_CUT, "count cut"}, {BVH::SAH, "SAH"},
+            {BVH::LBVH, "LBVH"}, {BVH::SBVH, "SBVH"}};
+    thread_pool pool(8);
+    for (const std::pair<BVH, std::string> &builder : builders) {
+        LinearBVH serial, parallel;
+        serial.build(boxes, builder.first);
+        parallel.build(boxes, builder.first, 1, &pool);
+        const std::vector<LinearBVHNode> &a = serial.nodes(), &b = parallel.nodes();
+        bool same = a.size() == b.size() && serial.order() == parallel.order();
+        for (size_t i = 0; same && i < a.size(); ++i) {
+            same = a[i].offset == b[i].offset && a[i].prim_num == b[i].prim_num && a[i].axis == b[i].axis;
+            for (int k = 0; same && k < 3; ++k) {
+                same = a[i].min[k] == b[i].min[k] && a[i].max[k] == b[i].max[k];
+            }
+        }
+        if (!same) {
+            std::cout << "FAIL parallel " << builder.second << " build differs from the serial one" << std::endl;
+            ++failures;
+        } else {
+            std::cout << "ok   parallel " << builder.second << " build matches the serial one" << std::endl;
+        }
+    }
+}
+
+/**
+ * Recolor surfaces of a scene frame after frame, and one outside of any scene. The entries of the old colors
+ * have to be reused, and the material of a surface has to stay where references to it point.
+ */
+static void check_materials() {
+    Scene scene;
+    std::vector<Sphere *> spheres;
+    for (int i = 0; i < 100; ++i) {
+        spheres.push_back(&scene.sphere(0, 0, 0, 1, Material{i / 100.0f, .5f, .5f}));
+    }
+    const Material &first = spheres[0]->material();
+    uint32_t most = 0;
+    for (int frame = 1; frame <= 100; ++frame) {
+        for (int i = 0; i < 100; ++i) {
+            spheres[i]->made_of(Material{i / 100.0f, frame / 100.0f, .5f});
+            most = std::max(most, spheres[i]->material_id());
+        }
+    }
+    Sphere standalone{0, 0, 0, 1};
+    standalone.made_of(Material{.1f, .2f, .3f});
+    bool ok = most <= 100 && &spheres[0]->material() == &first && first == Material{0, 1, .5f} &&
+              standalone.material() == Material{.1f, .2f, .3f};
+    if (!ok) {
+        std::cout << "FAIL recolored surfaces do not reuse their material entries" << std::endl;
+        ++failures;
+    } else {
+        std::cout << "ok   recolored surfaces reuse their material entries" << std::endl;
+    }
+}
+
+static void check(const Image &expected, const Image &actual, const std::string &what) {
+    int differ = 0;
+    for (int y = 0; y < expected.height(); ++y) {
+        for (int x = 0; x < expected.width(); ++x) {
+            differ += !(expected.pixel(x, y) == actual.pixel(x, y));
+        }
+    }
+    if (differ) {
+        std::cout << "FAIL " << what << ": " << differ << " pixels differ" << std::endl;
+        ++failures;
+    } else {
+        std::cout << "ok   " << what << std::endl;
+    }
+}
+
+/**
+ * Render one scene of spheres, triangles, a triangle mesh, mesh instances and a plane in ways that have to
+ * give the same image, e.g. through every BVH builder and by brute force. Exits with 1 if any differ.
+ * Run by ctest from the build directory, where it writes the obj file of the mesh.
+ */
+int main() {
+    write_obj(OBJ_FILE);
+    const Image reference = render(nullptr);
+
+    const std::vector<std::pair<BVH, std::string>> builders{
+            {BVH::VOLUME_CUT, "volume cut BVH"}, {BVH::SAH, "SAH BVH"}, {BVH::LBVH, "LBVH"}};
+    for (const std::pair<BVH, std::string> &builder : builders) {
+        const BVH mode = builder.first;
+        check(reference, render([mode](SceneConfig &config) {
+            config.render_flag(Render::BVH).bvh_mode(mode);
+        }), builder.second + " matches brute force");
+    }
+    BVHStats sah, sbvh;
+    render([](SceneConfig &config) {
+        config.render_flag(Render::BVH).bvh_mode(BVH::SAH);
+    }, 0, false, &sah);
+    check(reference, render([](SceneConfig &config) {
+        config.render_flag(Render::BVH).bvh_mode(BVH::SBVH);
+    }, 0, false, &sbvh), "SBVH matches brute force");
+    if (sbvh.reference_num <= sah.reference_num) {
+        // every primitive is referenced once without spatial splits
+        std::cout << "FAIL SBVH made no spatial split" << std::endl;
+        ++failures;
+    }
+    for (unsigned width : {4u, 8u}) {
+        check(reference, render([width](SceneConfig &config) {
+            config.render_flag(Render::BVH).bvh_mode(BVH::SAH).bvh_width(width);
+        }), std::to_string(width) + "-wide BVH matches brute force");
+    }
+
+    for (unsigned width : {2u, 4u}) {
+        check(reference, render([width](SceneConfig &config) {
+            config.render_flag(Render::BVH).bvh_mode(BVH::SAH).bvh_width(width).packet_tracing(true);
+        }), "packets through the " + std::to_string(width) + "-wide BVH match single rays");
+    }
+
+    for (TileOrder order : {TileOrder::LINEAR, TileOrder::MORTON}) {
+        check(reference, render([order](SceneConfig &config) {
+            config.parallel_method(ParallelMethod::TILE_COUNTER).tile_order(order);
+        }), std::string("tile counter in ") + (order == TileOrder::MORTON ? "Morton" : "linear")
+            + " order matches the thread pool");
+    }
+    check_parallel_build();
+    check(render_crowd(nullptr), render_crowd([](SceneConfig &config) {
+        config.parallel_method(ParallelMethod::WORK_STEALING);
+    }), "work-stealing pool matches the thread pool");
+
+    // an empty image has no tiles to hand out, the render returns without any
+    Scene empty;
+    empty.sphere();
+    empty.camera().image_size(0, 0);
+    empty.config().parallel_method(ParallelMethod::TILE_COUNTER).logging(false);
+    empty.render();
+
+    check_materials();
+
+    // surfaces added and removed again, some with a render in between, leave the scene as it was
+    {
+        Scene scene;
+        build(scene);
+        reference_config(scene.config());
+        std::vector<Surface *> extra;
+        for (int i = 0; i < 300; ++i) {
+            extra.push_back(&scene.sphere(i % 20 - 10, 1, -i / 20, .3f));
+            extra.push_back(&scene.triangle(i % 20 - 10, 2, -i / 20, i % 20 - 9, 2, -i / 20, i % 20 - 10, 3, -i / 20));
+        }
+        extra.push_back(&scene.plane(1, 0, 0, -5));
+        for (size_t i = 0; i < extra.size(); i += 2) {
+            scene.remove(*extra[i]);
+        }
+        scene.render();
+        for (size_t i = 1; i < extra.size(); i += 2) {
+            scene.remove(*extra[i]);
+        }
+        scene.render();
+        check(reference, scene.camera().image(), "scene with surfaces added and removed matches one without");
+    }
+
+    Scene scene;
+    Movable movable = build(scene);
+    check_occluded(*movable.spheres[0], 1, "sphere occlusion matches closest hits");
+    check_occluded(*movable.triangle, 1, "triangle occlusion matches closest hits");
+    check_occluded(*movable.mesh, movable.mesh->prim_num(), "triangle mesh occlusion matches closest hits");
+    check_occluded(*movable.instance, movable.instance->mesh().size(), "instance occlusion matches closest hits");
+
+    // the surfaces move after a first frame, refit_threshold(0) refits the tree instead of rebuilding it
+    for (unsigned width : {2u, 4u}) {
+        const Image rebuilt = render([width](SceneConfig &config) {
+            config.render_flag(Render::BVH).bvh_mode(BVH::SAH).bvh_width(width);
+        }, 1.5f);
+        check(rebuilt, render([width](SceneConfig &config) {
+            config.render_flag(Render::BVH).bvh_mode(BVH::SAH).bvh_width(width).refit_threshold(0);
+        }, 1.5f, true), "refitted " + std::to_string(width) + "-wide BVH matches a rebuilt one");
+    }
+
+    return failures ? 1 : 0;
+}
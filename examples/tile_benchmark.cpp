@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "mmgl/mmgl.h"
+
+using namespace mmgl;
+
+/**
+ * Render teapot.txt with each tile order and print the best of a few runs.
+ * Usage: tile_benchmark [thread_num [tile_size]]
+ */
+int main(int argc, char *argv[]) {
+    Scene scene("teapot.txt");
+
+    if (argc >= 2) {
+        scene.config().thread_num(std::stoi(argv[1]));
+    }
+    if (argc >= 3) {
+        scene.config().tile_size(std::stoi(argv[2]), std::stoi(argv[2]));
+    }
+    scene.config().pixel_sampling_num(1)
+                  .recursive_limit(2)
+                  .render_flag(Render::BVH)
+                  .logging(false);
+
+    const int runs = 5;
+    const std::pair<TileOrder, std::string> orders[] = {{TileOrder::LINEAR, "linear"},
+                                                        {TileOrder::MORTON, "morton"}};
+    for (const auto &order : orders) {
+        scene.config().tile_order(order.first);
+        double best = 0;
+        for (int i = 0; i < runs; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            scene.render();
+            std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+            best = i == 0 ? time.count() : std::min(best, time.count());
+        }
+        std::cout << order.second << ": " << best << " ms" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mmgl/mmgl.h"
+
+using namespace mmgl;
+
+static const int ROUNDS = 20;
+static const int OUTER = 8;
+static const int INNER = 4 * DEQUE_INITIAL_CAPACITY;
+static const int LEAF = 4;
+
+/**
+ * Stress the work-stealing pool with nested tasks. Every outer task, submitted from this thread through the
+ * shared queue, submits INNER tasks from its worker, which overflow the initial ring of its deque, and each
+ * of those submits LEAF more. The waiting workers take from the bottom of their deques while idle workers
+ * steal from the top. Every task has to run exactly once, and the pool has to shut down once idle.
+ * Exits with 1 if any task ran twice or never.
+ */
+int main() {
+    const int inner_num = OUTER * INNER, leaf_num = inner_num * LEAF;
+    std::unique_ptr<std::atomic<int>[]> inner_runs(new std::atomic<int>[inner_num]());
+    std::unique_ptr<std::atomic<int>[]> leaf_runs(new std::atomic<int>[leaf_num]());
+
+    int wrong = 0;
+    {
+        work_stealing_pool pool(4);
+        for (int round = 0; round < ROUNDS; ++round) {
+            for (int i = 0; i < inner_num; ++i) {
+                inner_runs[i] = 0;
+            }
+            for (int i = 0; i < leaf_num; ++i) {
+                leaf_runs[i] = 0;
+            }
+            std::vector<std::future<void>> outers;
+            for (int o = 0; o < OUTER; ++o) {
+                outers.push_back(pool.submit([&, o]() {
+                    std::vector<std::future<void>> inners;
+                    for (int i = o * INNER; i < (o + 1) * INNER; ++i) {
+                        inners.push_back(pool.submit([&, i]() {
+                            inner_runs[i]++;
+                            std::vector<std::future<void>> leaves;
+                            for (int l = i * LEAF; l < (i + 1) * LEAF; ++l) {
+                                leaves.push_back(pool.submit([&, l]() {
+                                    leaf_runs[l]++;
+                                }));
+                            }
+                            for (std::future<void> &leaf : leaves) {
+                                pool.wait(leaf);
+                                leaf.get();
+                            }
+                        }));
+                    }
+                    for (std::future<void> &inner : inners) {
+                        pool.wait(inner);
+                        inner.get();
+                    }
+                }));
+            }
+            for (std::future<void> &outer : outers) {
+                pool.wait(outer);
+                outer.get();
+            }
+            for (int i = 0; i < inner_num; ++i) {
+                wrong += inner_runs[i] != 1;
+            }
+            for (int i = 0; i < leaf_num; ++i) {
+                wrong += leaf_runs[i] != 1;
+            }
+            if (round % 5 == 4) {
+                // let the workers park, the next round wakes them through the shared queue
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    if (wrong) {
+        std::cout << "FAIL " << wrong << " tasks of the work-stealing pool did not run exactly once" << std::endl;
+        return 1;
+    }
+    std::cout << "ok   every nested task of the work-stealing pool ran exactly once" << std::endl;
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <random>
@@ -18,14 +19,23 @@
 #include <ctime>
 #include <cmath>
 #include <cstdlib>
+#include <exception>
 #include <future>
+#include <mutex>
 #include <functional>
 
 #include "mmgl/light/pointlight.h"
 #include "mmgl/light/ambientlight.h"
 #include "mmgl/light/arealight.h"
-#include "mmgl/surface/bvh_node.h"
+#include "mmgl/surface/accelerator.h"
+#include "mmgl/surface/instance.h"
+#include "mmgl/surface/sphere.h"
+#include "mmgl/surface/surface.h"
+#include "mmgl/surface/triangle.h"
+#include "mmgl/surface/triangle_mesh.h"
+#include "mmgl/util/cost_map.h"
 #include "mmgl/util/scene_config.h"
+#include "mmgl/util/stats.h"
 #include "mmgl/util/image.h"
 #include "mmgl/util/thread_pool.h"
 
@@ -113,9 +123,14 @@ public:
 
     /**
      * Render function called inside Scene class. Users of the library don't need to call this directly.
+     * The leaves of accel index into prims, the brute-force modes test all of them.
+     * The pool runs the partitions when the parallel method is ParallelMethod::THREAD_POOL or
+     * ParallelMethod::WORK_STEALING, Scene passes the matching pool. With ParallelMethod::TILE_COUNTER it runs
+     * one worker per thread of the pool instead, which take single tiles off a shared counter, and rethrows
+     * the first exception of a worker once all of them stopped.
      */
-    void render(const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                const BVHNode *const parent, const SceneConfig &sceneConfig);
+    void render(const std::vector<Primitive> &prims, const std::vector<Light *> &lights,
+                const Accelerator &accel, const SceneConfig &sceneConfig, task_pool &pool);
 
     void writeRgba(const std::string &) const;
 
@@ -135,6 +150,20 @@ public:
         return _image;
     }
 
+    /**
+     * Work counters of the last render, merged from all partitions.
+     */
+    inline const RenderStats &stats() const {
+        return _stats;
+    }
+
+    /**
+     * Block and task times of the last render.
+     */
+    inline const CostMap &cost_map() const {
+        return _cost_map;
+    }
+
     /**
      * Return a handle to the rendering results, called in Scene.
      */
@@ -145,24 +174,121 @@ public:
     friend std::ostream &operator<<(std::ostream &os, const Camera &camera);
 
 private:
-    void render_partition(const size_t partition_id, const size_t partition_size,
-                          const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                          const BVHNode *const parent, const SceneConfig &sceneConfig);
+    /**
+     * A light with its type looked up once per render, so shading switches on kind instead of casting.
+     */
+    struct LightRef {
+        enum class Kind {
+            POINT, AMBIENT, AREA
+        };
+
+        Kind kind;
+        Light *light;
+    };
+
+    /**
+     * A PACKET_WIDTH x PACKET_WIDTH pixel block, by its top left pixel. Blocks are the unit of the render
+     * schedule, one packet or PACKET_SIZE single rays each.
+     */
+    struct Block {
+        int x0, y0;
+    };
+
+    /**
+     * Lay out the blocks of the image in the tile order of the config. Tiles are runs of consecutive
+     * blocks, the partitions split the tiles between them.
+     */
+    void schedule(const SceneConfig &sceneConfig);
+
+    /**
+     * Split the block schedule into task_num tasks, runs of blocks in schedule order. They have the same
+     * number of tiles, or, if adaptive and the last render was of the same size, the same cost in its cost map.
+     */
+    void tasks(size_t task_num, bool adaptive);
+
+    /**
+     * Render the tasks of one partition. The render path from here down is instantiated once per Render mode
+     * and render() picks the instance from the scene config: the leaf loops call the sphere, triangle, mesh and
+     * instance kernels for R, so the mode is not checked per primitive. Other surfaces get R through the
+     * virtual interface and shading still switches on the kind of each light.
+     */
+    template<Render R>
+    void render_partition(const size_t partition_id,
+                          const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                          const Accelerator &accel, const SceneConfig &sceneConfig, RenderStats &stats);
 
-    Vector render_pixel(int x, int y, const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                        const BVHNode *const parent, const SceneConfig &sceneConfig,
-                        const std::function<float()> &rand_float);
+    /**
+     * Render one task after another, taking the next from next_task, until all tasks are taken.
+     * Used by ParallelMethod::TILE_COUNTER.
+     */
+    template<Render R>
+    void render_worker(std::atomic<size_t> &next_task,
+                       const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                       const Accelerator &accel, const SceneConfig &sceneConfig, RenderStats &stats);
+
+    /**
+     * Render the blocks of one task, recording their times in the cost map. The primary rays count into stats,
+     * and the rays spawned from them take the counters over, so the kernels reach them through the ray.
+     */
+    template<Render R>
+    void render_task(size_t task,
+                     const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                     const Accelerator &accel, const SceneConfig &sceneConfig,
+                     const std::function<float()> &rand_float, RenderStats &stats);
+
+    /**
+     * Sum up the work counters of all partitions or workers into the stats of the render.
+     */
+    void merge_stats(const std::vector<RenderStats> &stats);
+
+    /**
+     * Render the pixels [x0, x1) x [y0, y1) of a block, tracing the primary rays of each sample as one packet.
+     */
+    template<Render R>
+    void render_block(int x0, int y0, int x1, int y1,
+                     const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                     const Accelerator &accel, const SceneConfig &sceneConfig,
+                     const std::function<float()> &rand_float, RenderStats &stats);
+
+    template<Render R>
+    Vector render_pixel(int x, int y, const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                        const Accelerator &accel, const SceneConfig &sceneConfig,
+                        const std::function<float()> &rand_float, RenderStats &stats);
 
+    template<Render R>
     Vector L(Ray &ray, int recursive_limit, const Surface *const object_id,
-             const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-             const BVHNode *const parent, const Render &flag, int s_sampling_nu,
-             const std::function<float()> &rand_float);
+             const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+             const Accelerator &accel, int s_sampling_nu, const std::function<float()> &rand_float);
 
+    /**
+     * Shade the closest hit of a ray that was already intersected, tracing its shadow and reflection rays.
+     */
+    template<Render R>
+    Vector shade(const Ray &ray, int recursive_limit,
+                 const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                 const Accelerator &accel, int s_sampling_num, const std::function<float()> &rand_float);
+
+    template<Render R>
     std::pair<bool, Vector> blinn_phong(const Ray &pri_ray, const Point &light_pt, const Vector &light_cl,
                                         const Intersection &intersection,
-                                        const Material &material, const std::vector<Surface *> &objects,
-                                        const BVHNode *const parent,
-                                        const Render &flag);
+                                        const Material &material, const std::vector<Primitive> &prims,
+                                        const Accelerator &accel);
+
+    inline size_t blocks_x() const {
+        return static_cast<size_t>((_nx + PACKET_WIDTH - 1) / PACKET_WIDTH);
+    }
+
+    inline size_t blocks_y() const {
+        return static_cast<size_t>((_ny + PACKET_WIDTH - 1) / PACKET_WIDTH);
+    }
+
+    inline size_t tile_num() const {
+        return _tile_first.size() - 1;
+    }
+
+    inline size_t task_num() const {
+        return _task_first.size() - 1;
+    }
 
     Point _eye;
     float _d;
@@ -171,6 +297,12 @@ private:
     int _ny;
     float _l, _r, _t, _b;
     Image _image;
+    RenderStats _stats;
+    std::vector<Block> _blocks;
+    std::vector<size_t> _tile_first{0};  // blocks of tile i are [_tile_first[i], _tile_first[i + 1])
+    std::vector<size_t> _task_first{0};  // blocks of task i are [_task_first[i], _task_first[i + 1])
+    CostMap _cost_map;
+    bool _morton_pixels = false;
 };
 
 }
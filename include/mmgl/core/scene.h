@@ -6,13 +6,20 @@
 #ifndef RAYTRACER_SCENE_H
 #define RAYTRACER_SCENE_H
 
+#include <algorithm>
 #include <vector>
-#include <queue>
 #include <chrono>
+#include <memory>
+#include <unordered_map>
 
 #include "mmgl/core/camera.h"
+#include "mmgl/core/surface_store.h"
+#include "mmgl/surface/instance.h"
+#include "mmgl/surface/plane.h"
 #include "mmgl/surface/sphere.h"
 #include "mmgl/surface/triangle.h"
+#include "mmgl/surface/triangle_mesh.h"
+#include "mmgl/util/work_stealing_pool.h"
 
 namespace mmgl {
 
@@ -21,12 +28,14 @@ namespace mmgl {
  * The configuration parameters are in _config of type SceneConfig.
  * The Camera object _camera is used for rendering.
  */
-class Scene {
+class Scene : private SurfaceListener {
 public:
     /**
      * Default and minimal Scene constructor. It also sets a default camera for convenient usage.
      */
-    Scene() : _surfaces{}, _lights{}, _camera{}, _config{} {
+    Scene() : _materials{}, _surfaces{}, _positions{}, _removed_num{0}, _spheres{}, _triangles{}, _meshes{}, _lights{}, _camera{}, _config{}, _prims{}, _bounded_num{0},
+              _prims_dirty{true}, _accel{}, _accel_dirty{true}, _first_prim{}, _changed{}, _bvh_stats{},
+              _pool{}, _pool_shared{false}, _pool_threads{0}, _pool_method{ParallelMethod::THREAD_POOL} {
         configCamera(10, 10, 10, -1, -1, -1, 100, 100, 100, 1000, 1000);
     }
 
@@ -59,7 +68,44 @@ public:
     }
 
     /**
-     * Performs rendering.
+     * Statistics of the BVH as of the last build or refit.
+     */
+    inline const BVHStats &bvh_stats() const {
+        return _bvh_stats;
+    }
+
+    /**
+     * Time spent on each block of the image and on each partition in the last render. With
+     * SceneConfig::adaptive_partitions the next render balances its partitions by these times.
+     */
+    inline const CostMap &cost_map() const {
+        return _camera.cost_map();
+    }
+
+    /**
+     * Work counters of the last render.
+     */
+    inline const RenderStats &render_stats() const {
+        return _camera.stats();
+    }
+
+    /**
+     * The pool rendering this scene and building its BVH. Unless a pool was shared in, the scene owns it, keeps it
+     * between renders and only recreates it when SceneConfig::thread_num or the parallel method changes.
+     * Hand it to pool(std::shared_ptr<task_pool>) of other scenes to run them all on the same threads.
+     */
+    std::shared_ptr<task_pool> pool();
+
+    /**
+     * Render on a pool shared with other scenes or owned by the caller, SceneConfig::thread_num then no longer
+     * applies. A null pool goes back to a pool owned by the scene.
+     */
+    Scene &pool(std::shared_ptr<task_pool> pool);
+
+    /**
+     * Performs rendering. The BVH is kept between calls and only rebuilt after surfaces were added or
+     * removed, or the BVH options changed, so re-rendering after camera or light changes skips the build.
+     * Moved surfaces refit the BVH instead, until its quality drops past SceneConfig::refit_threshold.
      */
     void render();
 
@@ -74,7 +120,8 @@ public:
 
     /**
      * Add a new sphere in the current scene.
-     * Return a reference so the configurations can be chained together.
+     * Return a reference so the configurations can be chained together, it stays valid until the sphere is removed.
+     * Spheres are stored together, so the camera tests them without virtual calls.
      * Default size is unit size and at the origin posision.
      */
     Sphere &sphere(float x = .0f, float y = .0f, float z = .0f, float radius = 1.0f,
@@ -82,13 +129,40 @@ public:
 
     /**
      * Add a new triangle in the current scene.
-     * Return a reference so the configurations can be chained together.
+     * Return a reference so the configurations can be chained together, it stays valid until the triangle is removed.
+     * Triangles are stored together like spheres.
      */
     Triangle &triangle(float x1 = 1.0f, float y1 = .0f, float z1 = .0f,
                        float x2 = .0f, float y2 = 1.0f, float z2 = .0f,
                        float x3 = .0f, float y3 = .0f, float z3 = 1.0f,
                        const Material &material = Material{});
 
+    /**
+     * Add an infinite plane, the points p with normal . p = d, in the current scene.
+     * Planes are not in the BVH, every ray tests them first.
+     */
+    Plane &plane(float nx = .0f, float ny = 1.0f, float nz = .0f, float d = .0f,
+                 const Material &material = Material{});
+
+    /**
+     * Add the triangles of an OBJ file as one triangle mesh, sharing its vertices and the material.
+     * The scene BVH indexes the triangles of the mesh one by one.
+     */
+    TriangleMesh &triangle_mesh(const std::string &obj_file, const Material &material = Material{});
+
+    /**
+     * Load an OBJ file as a mesh owned by the scene and build its bottom-level BVH.
+     * Loading the same file again returns the mesh already loaded. The mesh is only rendered through instances.
+     */
+    const Mesh &mesh(const std::string &obj_file);
+
+    /**
+     * Add an instance of a mesh placed by an object to world transform.
+     * All instances of a mesh share its triangles and bottom-level BVH, the scene BVH is built over the instances.
+     */
+    Instance &instance(const Mesh &mesh, const Transform &transform = Transform{},
+                       const Material &material = Material{});
+
     /**
      * Add a point light to the current scene.
      */
@@ -107,13 +181,56 @@ public:
      */
     AmbientLight &ambientLight(float r = .03f, float g = .03f, float b = .03f);
 
+    /**
+     * Remove a surface added to the current scene and release it.
+     */
+    void remove(const Surface &surface);
+
     ~Scene();
 
 private:
-    std::vector<Surface *> _surfaces;
+    /**
+     * Called by the surfaces of this scene whenever their geometry changes.
+     */
+    void surface_changed(const Surface &surface);
+
+    /**
+     * Start rendering a new surface and listening to its changes, its material goes into the table.
+     * Spheres and triangles live in their typed stores, the scene owns other surfaces through _surfaces.
+     */
+    template<typename T>
+    T &add(T &surface, const Material &material) {
+        surface.listener(this);
+        surface.materials(&_materials);
+        surface.material(material);
+        _positions[&surface] = _surfaces.size();
+        _surfaces.push_back(&surface);
+        _prims_dirty = true;
+        return surface;
+    }
+
+    MaterialTable _materials;   // declared first, the surfaces refer to it until they are deleted
+    std::vector<Surface *> _surfaces;   // all surfaces in the order they were added, null where one was removed
+    std::unordered_map<const Surface *, size_t> _positions;   // of every surface in _surfaces
+    size_t _removed_num;    // null entries in _surfaces, closed up by the next render
+    SurfaceStore<Sphere> _spheres;
+    SurfaceStore<Triangle> _triangles;
+    std::unordered_map<std::string, Mesh *> _meshes;
     std::vector<Light *> _lights;
     Camera _camera;
     SceneConfig _config;
+    std::vector<Primitive> _prims;
+    uint32_t _bounded_num;  // the BVH is built over _prims[0, _bounded_num), the rest are unbounded
+    bool _prims_dirty;
+    Accelerator _accel;
+    bool _accel_dirty;
+    std::unordered_map<const Surface *, uint32_t> _first_prim;
+    std::vector<uint32_t> _changed;
+    BVHStats _bvh_stats;
+    std::shared_ptr<task_pool> _pool;
+    bool _pool_shared;      // set by the caller, never resized by the scene
+    unsigned _pool_threads;
+    ParallelMethod _pool_method;
 
 };  // class Scene
 
@@ -0,0 +1,61 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_SURFACE_STORE_H
+#define RAYTRACER_SURFACE_STORE_H
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "mmgl/surface/surface.h"
+
+namespace mmgl {
+
+/**
+ * Contiguous storage for the surfaces of one type in a scene, instead of one heap allocation each.
+ * Surfaces are kept in chunks of a deque, so references handed out stay valid while others are added.
+ * The slot of a removed surface is reused by the next one added.
+ */
+template<typename T>
+class SurfaceStore {
+public:
+    SurfaceStore() : _items{}, _free{} { }
+
+    template<typename... Args>
+    T &add(Args &&... args) {
+        uint32_t slot;
+        if (_free.empty()) {
+            slot = static_cast<uint32_t>(_items.size());
+            _items.emplace_back(std::forward<Args>(args)...);
+        } else {
+            slot = _free.back();
+            _free.pop_back();
+            _items[slot] = T(std::forward<Args>(args)...);
+        }
+        _items[slot].slot(slot);
+        return _items[slot];
+    }
+
+    /**
+     * Free the slot of surface, false if it is not in this store. Found by Surface::slot in constant time.
+     */
+    bool remove(const Surface &surface) {
+        uint32_t slot = surface.slot();
+        if (slot >= _items.size() || &_items[slot] != &surface) {
+            return false;
+        }
+        _free.push_back(slot);
+        return true;
+    }
+
+private:
+    std::deque<T> _items;
+    std::vector<uint32_t> _free;
+};
+
+}
+
+#endif //RAYTRACER_SURFACE_STORE_H
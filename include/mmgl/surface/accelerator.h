@@ -0,0 +1,162 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_ACCELERATOR_H
+#define RAYTRACER_ACCELERATOR_H
+
+#include <functional>
+#include <vector>
+
+#include "mmgl/surface/linear_bvh.h"
+#include "mmgl/surface/wide_bvh.h"
+
+namespace mmgl {
+
+/**
+ * The acceleration structure used by the camera. It always keeps the binary LinearBVH and,
+ * for a width of 4 or 8, traverses the WideBVH collapsed from it instead.
+ * Unbounded primitives are not in the trees, every query visits them first as one extra leaf,
+ * so an infinite plane tightens the closest hit before any node is tested.
+ */
+class Accelerator {
+public:
+    Accelerator() : _bvh_mode{BVH::VOLUME_CUT}, _width{2}, _leaf_size{1}, _bvh{}, _wide_bvh{}, _updated{},
+                    _unbounded{} { }
+
+    /**
+     * Build over the primitive boxes, leaves refer to primitives by their index in boxes.
+     * @param width 2 for the binary tree, 4 or 8 for the wide one.
+     * @param leaf_size Most primitives in a leaf, see LinearBVH::build.
+     * @param pool Thread pool for a parallel build, nullptr builds serially.
+     * @param clip Clipper for the spatial splits of BVH::SBVH.
+     */
+    void build(const std::vector<BBox> &boxes, const BVH &bvh_mode, unsigned width, unsigned leaf_size = 1,
+               task_pool *pool = nullptr, const BoxClipper &clip = nullptr);
+
+    void clear();
+
+    /**
+     * Refit both trees to moved primitives, see LinearBVH::refit.
+     * @param threshold Give up once the SAH cost grew past threshold times the cost after the build,
+     *                  0 always refits.
+     * @return false if the tree degraded past the threshold or has spatial splits, and should be rebuilt.
+     */
+    bool refit(const std::function<BBox(uint32_t)> &box_of, const std::vector<uint32_t> &changed,
+               float threshold, task_pool *pool = nullptr);
+
+    inline bool empty() const {
+        return _bvh.empty();
+    }
+
+    /**
+     * Set the primitives tested by every query besides the trees, they are kept across builds.
+     * Their indices must not collide with those of the boxes the trees are built over.
+     */
+    inline void unbounded(std::vector<uint32_t> &&prims) {
+        _unbounded = std::move(prims);
+    }
+
+    inline const std::vector<uint32_t> &unbounded() const {
+        return _unbounded;
+    }
+
+    inline const BVH &bvh_mode() const {
+        return _bvh_mode;
+    }
+
+    inline unsigned width() const {
+        return _width;
+    }
+
+    inline unsigned leaf_size() const {
+        return _leaf_size;
+    }
+
+    /**
+     * Statistics of the binary tree, plus the node count and memory of the wide tree in use.
+     */
+    BVHStats stats() const;
+
+    inline const LinearBVH &bvh() const {
+        return _bvh;
+    }
+
+    inline const WideBVH &wide_bvh() const {
+        return _wide_bvh;
+    }
+
+    /**
+     * Same contract as LinearBVH::intersect, using the tree of the configured width.
+     */
+    template<typename Intersector>
+    inline void intersect(Ray &ray, Intersector &&intersector) const {
+        for (uint32_t prim : _unbounded) {
+            intersector(prim);
+        }
+        if (_width == 2) {
+            _bvh.intersect(ray, intersector);
+        } else {
+            _wide_bvh.intersect(ray, intersector);
+        }
+    }
+
+    /**
+     * Same contract as LinearBVH::intersect_leaves, using the tree of the configured width.
+     */
+    template<typename LeafIntersector>
+    inline void intersect_leaves(Ray &ray, LeafIntersector &&leaf_intersector) const {
+        if (!_unbounded.empty()) {
+            leaf_intersector(_unbounded.data(), static_cast<uint32_t>(_unbounded.size()));
+        }
+        if (_width == 2) {
+            _bvh.intersect_leaves(ray, leaf_intersector);
+        } else {
+            _wide_bvh.intersect_leaves(ray, leaf_intersector);
+        }
+    }
+
+    /**
+     * Same contract as LinearBVH::occluded, using the tree of the configured width.
+     */
+    template<typename LeafOccluder>
+    inline bool occluded(const Ray &ray, float t_max, LeafOccluder &&leaf_occluder) const {
+        if (!_unbounded.empty() && leaf_occluder(_unbounded.data(), static_cast<uint32_t>(_unbounded.size()))) {
+            return true;
+        }
+        if (_width == 2) {
+            return _bvh.occluded(ray, t_max, leaf_occluder);
+        } else {
+            return _wide_bvh.occluded(ray, t_max, leaf_occluder);
+        }
+    }
+
+    /**
+     * Same contract as LinearBVH::intersect_packet. Packets always walk the binary tree,
+     * the wide tree is collapsed from it and tests the children of a node for a single ray only.
+     */
+    template<typename LeafIntersector>
+    inline void intersect_packet(RayPacket &packet, LeafIntersector &&leaf_intersector) const {
+        if (!_unbounded.empty()) {
+            for (unsigned lane = 0; lane < packet.size(); ++lane) {
+                leaf_intersector(packet.ray(lane), _unbounded.data(), static_cast<uint32_t>(_unbounded.size()));
+                packet.update(lane);
+            }
+        }
+        _bvh.intersect_packet(packet, leaf_intersector);
+    }
+
+private:
+    BVH _bvh_mode;
+    unsigned _width;
+    unsigned _leaf_size;
+    LinearBVH _bvh;
+    WideBVH _wide_bvh;
+    std::vector<uint32_t> _updated;
+    std::vector<uint32_t> _unbounded;
+};
+
+}
+
+#endif //RAYTRACER_ACCELERATOR_H
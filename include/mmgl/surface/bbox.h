@@ -6,10 +6,12 @@
 #ifndef RAYTRACER_BBOX_H
 #define RAYTRACER_BBOX_H
 
+#include <algorithm>
 #include <map>
 #include <limits>
 
 #include "mmgl/surface/ray.h"
+#include "mmgl/util/stats.h"
 
 #define TOLERANCE 0.001f
 #define BOUNDING 0.002f
@@ -40,6 +42,39 @@ public:
         return _max;
     }
 
+    /**
+     * Center of the box along one axis, 0 for x, 1 for y and 2 for z.
+     */
+    inline float center(int axis) const {
+        return (_min[axis] + _max[axis]) * 0.5f;
+    }
+
+    /**
+     * Grow this box to enclose the other one, the BOUNDING padding is not added again.
+     */
+    void merge(const BBox &other);
+
+    /**
+     * The part of this box that is also inside the other one, an empty() box if they do not overlap.
+     */
+    BBox overlap(const BBox &other) const;
+
+    /**
+     * Whether the box encloses anything, false for empty() and for boxes left from a missed overlap.
+     */
+    inline bool valid() const {
+        return _min._x <= _max._x && _min._y <= _max._y && _min._z <= _max._z;
+    }
+
+    float area() const;
+
+    float volume() const;
+
+    /**
+     * An inverted box that the first merge overrides, used as the start of a union.
+     */
+    static BBox empty();
+
 private:
     Point _min, _max;
 };
@@ -0,0 +1,80 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_INSTANCE_H
+#define RAYTRACER_INSTANCE_H
+
+#include <sstream>
+
+#include "mmgl/surface/mesh.h"
+#include "mmgl/util/transform.h"
+
+namespace mmgl {
+
+/**
+ * Class for mesh instances, a shared Mesh placed in the scene by a transform.
+ * Derived from Surface base class, so the scene BVH over all surfaces is the top level over the instances
+ * and moving an instance only refits or rebuilds that top level.
+ */
+class Instance : public Surface {
+public:
+    Instance(const Mesh &mesh, const Transform &transform = Transform{});
+
+    /**
+     * Move the ray into object space, traverse the bottom-level BVH of the mesh and map the hit back.
+     */
+    bool intersect(Ray &, const Render &) const;
+
+    /**
+     * Intersect with the Render mode fixed at compile time, the camera calls this one from its leaf loops.
+     */
+    template<Render R>
+    bool intersect(Ray &ray) const;
+
+    /**
+     * Occlusion query in object space, through the bottom-level BVH.
+     */
+    bool occluded(const Ray &ray, const Render &flag, uint32_t prim, float t_max) const;
+
+    template<Render R>
+    bool occluded(const Ray &ray, float t_max) const;
+
+    inline PrimType prim_type() const {
+        return PrimType::INSTANCE;
+    }
+
+    /**
+     * Normal of the hit mesh triangle, transformed to world space.
+     */
+    Vector normal(const Hit &hit, const Point &point) const;
+
+    std::string to_string() const;
+
+    inline const Mesh &mesh() const {
+        return *_mesh;
+    }
+
+    inline const Transform &transform() const {
+        return _to_world;
+    }
+
+    /**
+     * Set the object to world transform of the instance.
+     */
+    Instance &transform(const Transform &transform);
+
+    Instance &made_of(const Material &material);
+
+private:
+    void init();
+
+    const Mesh *_mesh;
+    Transform _to_world;
+    Transform _to_object;
+};
+
+}
+
+#endif //RAYTRACER_INSTANCE_H
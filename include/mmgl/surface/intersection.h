@@ -6,6 +6,9 @@
 #ifndef RAYTRACER_INTERSECTION_H
 #define RAYTRACER_INTERSECTION_H
 
+#include <cstdint>
+
+#include "mmgl/surface/material.h"
 #include "mmgl/util/vector.h"
 
 namespace mmgl {
@@ -13,15 +16,28 @@ namespace mmgl {
 class Surface;
 
 /**
- * Class for intersection.
+ * Hit record a ray keeps while it is traversed: the distance, the surface and primitive that were hit,
+ * and the barycentric coordinates of the second and third vertex for triangles. Candidates are replaced
+ * often, so the shading point and normal are only derived once the closest hit is known.
+ */
+struct Hit {
+    float t;
+    const Surface *id;
+    uint32_t prim;
+    float u, v;
+};
+
+/**
+ * Class for intersection. The id is the surface that was hit and prim the primitive inside it, the material
+ * is the one it is shaded with. A hit on a mesh has the mesh as id and the triangle index as prim.
  */
 class Intersection {
 public:
-    Intersection() : _t(0.0f), _point(), _normal(), _id(nullptr) { }
+    Intersection() : _t(0.0f), _point(), _normal(), _id(nullptr), _prim(0), _material(nullptr) { }
 
-    Intersection(float t, const Point &point, const Vector &normal, const Surface *const id) : _t(t), _point(point),
-                                                                                               _normal(normal),
-                                                                                               _id(id) { }
+    Intersection(float t, const Point &point, const Vector &normal, const Surface *const id,
+                 const Material *const material, uint32_t prim = 0)
+            : _t(t), _point(point), _normal(normal), _id(id), _prim(prim), _material(material) { }
 
     inline float t() const {
         return _t;
@@ -39,11 +55,21 @@ public:
         return _id;
     }
 
+    inline uint32_t prim() const {
+        return _prim;
+    }
+
+    inline const Material &material() const {
+        return *_material;
+    }
+
 private:
     float _t;
     Point _point;
     Vector _normal;
     const Surface *_id;
+    uint32_t _prim;
+    const Material *_material;
 };
 
 }
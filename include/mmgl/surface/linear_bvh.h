@@ -0,0 +1,394 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_LINEAR_BVH_H
+#define RAYTRACER_LINEAR_BVH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "mmgl/surface/bbox.h"
+#include "mmgl/surface/ray_packet.h"
+#include "mmgl/util/common.h"
+#include "mmgl/util/stats.h"
+
+#define SAH_BIN_NUM 16
+#define SAH_TRAVERSAL_COST 1.0f
+#define BVH_MAX_LEAF_SIZE 255
+#define BVH_STACK_SIZE 128
+#define BVH_MAX_CUT_DEPTH 64
+#define BVH_PARALLEL_THRESHOLD 4096
+#define LBVH_WIDE_KEY_THRESHOLD (1 << 20)
+#define SBVH_BIN_NUM 32
+#define SBVH_MAX_DUPLICATION 0.5f
+
+namespace mmgl {
+
+class task_pool;
+
+/**
+ * Bounds of the part of primitive index inside a box, used by BVH::SBVH to clip straddling primitives.
+ */
+using BoxClipper = std::function<BBox(uint32_t index, const BBox &bounds)>;
+
+/**
+ * Node of the linear BVH. Nodes are stored in depth-first order, so the first child of an interior node
+ * directly follows it and only the second child needs an offset. 32 bytes, two nodes share a cache line.
+ */
+struct LinearBVHNode {
+    float min[3];
+    float max[3];
+    uint32_t offset;    // leaf: first position in the primitive order, interior: index of the second child
+    uint16_t prim_num;  // number of primitives of a leaf, 0 for interior nodes
+    uint8_t axis;       // split axis of an interior node, used for front-to-back traversal
+    uint8_t pad;
+};
+
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode is expected to be 32 bytes");
+
+/**
+ * Pointer-free BVH kept in one array of nodes.
+ * The tree is built over primitive bounding boxes only, leaves refer to primitives by their index
+ * in the boxes passed to build(), so the same structure serves any kind of primitive.
+ */
+class LinearBVH {
+public:
+    LinearBVH() : _nodes{}, _order{}, _parents{}, _leaf_of{}, _area_sum{0}, _build_cost{0} { }
+
+    /**
+     * Build the tree over the given primitive boxes using the split heuristic of bvh_mode.
+     * With a pool, subtrees and the per-node work of ranges larger than BVH_PARALLEL_THRESHOLD run as tasks,
+     * the resulting tree is identical to the serial build.
+     * @param leaf_size Most primitives in a leaf, up to BVH_MAX_LEAF_SIZE. BVH::SAH and BVH::SBVH only make
+     *                  a leaf of that many where it is cheaper than splitting, the other modes always do.
+     * @param clip Clipper for BVH::SBVH, without one a primitive is clipped by its box.
+     */
+    void build(const std::vector<BBox> &boxes, const BVH &bvh_mode, unsigned leaf_size = 1,
+               task_pool *pool = nullptr, const BoxClipper &clip = nullptr);
+
+    void clear();
+
+    inline bool empty() const {
+        return _nodes.empty();
+    }
+
+    inline const std::vector<LinearBVHNode> &nodes() const {
+        return _nodes;
+    }
+
+    /**
+     * Primitive indices in leaf order, a leaf covers [offset, offset + prim_num) of this array.
+     */
+    inline const std::vector<uint32_t> &order() const {
+        return _order;
+    }
+
+    /**
+     * Number the primitives by their position in order(), for callers that store their primitives
+     * in leaf order so that every leaf covers a contiguous run of them.
+     * @throw RenderException if the tree is not refittable(), a primitive then has several positions.
+     */
+    void renumber();
+
+    /**
+     * Whether every primitive sits in exactly one leaf. Spatial splits reference a primitive from several
+     * leaves by clipped boxes, such a tree cannot be refitted.
+     */
+    inline bool refittable() const {
+        return _order.size() == _leaf_of.size();
+    }
+
+    /**
+     * Refit the tree to moved primitives while keeping its topology. The leaves holding a changed primitive
+     * take their bounds from box_of and the change is propagated up to the root, stopping where bounds
+     * stay the same. Change sets larger than BVH_PARALLEL_THRESHOLD refit the whole tree level by level on the pool.
+     * @param changed Indices of the moved primitives, may contain duplicates.
+     * @param updated Receives the indices of all nodes whose bounds were recomputed.
+     * @throw RenderException if the tree is not refittable().
+     */
+    void refit(const std::function<BBox(uint32_t)> &box_of, const std::vector<uint32_t> &changed,
+               task_pool *pool, std::vector<uint32_t> &updated);
+
+    /**
+     * SAH cost of the tree: node and primitive test counts weighted by their area relative to the root.
+     */
+    float sah_cost() const;
+
+    /**
+     * Node and leaf counts, leaf depths, SAH cost and memory of the tree.
+     */
+    BVHStats stats() const;
+
+    /**
+     * SAH cost right after the last build, refits compare against it.
+     */
+    inline float build_cost() const {
+        return _build_cost;
+    }
+
+    /**
+     * Traverse the tree front-to-back with an explicit stack. The intersector is called with the index
+     * of every primitive in a visited leaf and is expected to update the ray's closest intersection,
+     * which is then used to prune the remaining nodes.
+     */
+    template<typename Intersector>
+    void intersect(Ray &ray, Intersector &&intersector) const {
+        intersect_leaves(ray, [&](const uint32_t *prims, uint32_t count) {
+            for (uint32_t i = 0; i < count; ++i) {
+                intersector(prims[i]);
+            }
+        });
+    }
+
+    /**
+     * Same traversal, the leaf intersector is called once per visited leaf with the primitive indices
+     * of the leaf and their count, so it can test them as one batch.
+     */
+    template<typename LeafIntersector>
+    void intersect_leaves(Ray &ray, LeafIntersector &&leaf_intersector) const {
+        intersect_subtree(ray, 0, leaf_intersector);
+    }
+
+    /**
+     * Traverse the tree with a whole packet, each node is tested against all of its rays still active there.
+     * The leaf intersector is called with the ray of every lane reaching a leaf, the leaf primitive indices
+     * and their count. Once fewer than PACKET_MIN_ACTIVE rays hit a node, the packet has diverged and
+     * those rays finish the subtree one by one.
+     */
+    template<typename LeafIntersector>
+    void intersect_packet(RayPacket &packet, LeafIntersector &&leaf_intersector) const;
+
+    /**
+     * Occlusion query for shadow rays: traverse the nodes the ray enters before t_max, in no particular order,
+     * until the leaf occluder returns true for one leaf. It is called with the primitive indices of the leaf
+     * and their count, and the ray itself is never updated. Returns whether some leaf occluded the ray.
+     */
+    template<typename LeafOccluder>
+    bool occluded(const Ray &ray, float t_max, LeafOccluder &&leaf_occluder) const;
+
+private:
+    /**
+     * Single ray traversal of the subtree below root.
+     */
+    template<typename LeafIntersector>
+    void intersect_subtree(Ray &ray, uint32_t root, LeafIntersector &leaf_intersector) const;
+
+    /**
+     * BVH::LBVH build: Morton codes of the box centroids, 30 bits or 63 bits above LBVH_WIDE_KEY_THRESHOLD
+     * primitives, sorted with a parallel radix sort, then the hierarchy is emitted in linear time.
+     */
+    void build_lbvh(const std::vector<BBox> &boxes, unsigned leaf_size, task_pool *pool);
+
+    /**
+     * BVH::SBVH build: binned SAH object splits, plus spatial splits that clip the primitives straddling
+     * a plane into both children where that is cheaper. References grow by SBVH_MAX_DUPLICATION at most.
+     */
+    void build_sbvh(const std::vector<BBox> &boxes, unsigned leaf_size, const BoxClipper &clip, task_pool *pool);
+
+    /**
+     * Fill in parent links, the leaf of every primitive and the SAH area sum after a build.
+     */
+    void link(size_t prim_num);
+
+    /**
+     * Recompute the bounds of one node from its primitives or children, return whether they changed.
+     */
+    bool refit_node(uint32_t index, const std::function<BBox(uint32_t)> &box_of);
+
+    /**
+     * Slab test of a node box, pruned by the closest intersection found so far or the length of a shadow ray.
+     * A NaN from a zero direction component lying on a slab is dropped by the comparison order.
+     */
+    static inline bool node_intersect(const LinearBVHNode &node, float t_max,
+                                      const float *orig, const float *inv_dir) {
+        float t_near = -std::numeric_limits<float>::infinity();
+        float t_far = t_max;
+        for (int axis = 0; axis < 3; ++axis) {
+            float t0 = (node.min[axis] - orig[axis]) * inv_dir[axis];
+            float t1 = (node.max[axis] - orig[axis]) * inv_dir[axis];
+            t_near = std::max(t_near, std::min(t0, t1));
+            t_far = std::min(t_far, std::max(t0, t1));
+        }
+        return t_near <= t_far && t_far >= .0f;
+    }
+
+    /**
+     * Area of a node box, weighted by the number of tests a visit costs.
+     */
+    static inline double weighted_area(const LinearBVHNode &node) {
+        double dx = node.max[0] - node.min[0], dy = node.max[1] - node.min[1], dz = node.max[2] - node.min[2];
+        return (dx * dy + dy * dz + dz * dx) * (node.prim_num ? node.prim_num : 1);
+    }
+
+    std::vector<LinearBVHNode> _nodes;
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _parents;
+    std::vector<uint32_t> _leaf_of;
+    double _area_sum;
+    float _build_cost;
+};
+
+template<typename LeafIntersector>
+void LinearBVH::intersect_subtree(Ray &ray, uint32_t root, LeafIntersector &leaf_intersector) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float inv_dir[3] = {1.0f / ray.dir().x(), 1.0f / ray.dir().y(), 1.0f / ray.dir().z()};
+    const bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    uint32_t current = root;
+    uint64_t visited = 0;
+    while (true) {
+        const LinearBVHNode &node = _nodes[current];
+        ++visited;
+
+        bool hit = true;
+        if (node.prim_num != 1) {
+            // a single primitive leaf has the same box as the primitive, which tests it again on its own
+            float t_max = ray.has_intersect() ? ray.hit().t : std::numeric_limits<float>::infinity();
+            hit = node_intersect(node, t_max, orig, inv_dir);
+        }
+
+        if (hit && node.prim_num == 0) {
+            // visit the near child first, push the far one
+            if (dir_is_neg[node.axis]) {
+                stack[top++] = current + 1;
+                current = node.offset;
+            } else {
+                stack[top++] = node.offset;
+                current = current + 1;
+            }
+            continue;
+        }
+        if (hit) {
+            leaf_intersector(&_order[node.offset], node.prim_num);
+        }
+        if (top == 0) {
+            break;
+        }
+        current = stack[--top];
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->node_visits += visited;
+    }
+}
+
+template<typename LeafOccluder>
+bool LinearBVH::occluded(const Ray &ray, float t_max, LeafOccluder &&leaf_occluder) const {
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float inv_dir[3] = {1.0f / ray.dir().x(), 1.0f / ray.dir().y(), 1.0f / ray.dir().z()};
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    uint32_t current = 0;
+    uint64_t visited = 0;
+    bool blocked = false;
+    while (true) {
+        const LinearBVHNode &node = _nodes[current];
+        ++visited;
+
+        if (node.prim_num == 1 || node_intersect(node, t_max, orig, inv_dir)) {
+            if (node.prim_num == 0) {
+                stack[top++] = node.offset;
+                current = current + 1;
+                continue;
+            }
+            if (leaf_occluder(&_order[node.offset], node.prim_num)) {
+                blocked = true;
+                break;
+            }
+        }
+        if (top == 0) {
+            break;
+        }
+        current = stack[--top];
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->node_visits += visited;
+    }
+    return blocked;
+}
+
+template<typename LeafIntersector>
+void LinearBVH::intersect_packet(RayPacket &packet, LeafIntersector &&leaf_intersector) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    struct Entry {
+        uint32_t node;
+        unsigned active;
+    };
+    Entry stack[BVH_STACK_SIZE];
+    int top = 0;
+    uint32_t current = 0;
+    unsigned active = packet.mask();
+    uint64_t visited = 0;
+    while (true) {
+        const LinearBVHNode &node = _nodes[current];
+        ++visited;
+
+        unsigned hit = active;
+        if (node.prim_num != 1) {
+            // interval culling drops the whole packet at once, before the rays are tested one per lane
+            bool culled = packet.coherent() && packet.misses(node.min, node.max);
+            hit = culled ? 0 : packet.intersect(node.min, node.max, active);
+        }
+
+        if (hit && lane_num(hit) < PACKET_MIN_ACTIVE) {
+            for (unsigned lane = 0; lane < packet.size(); ++lane) {
+                if (hit & (1u << lane)) {
+                    auto lane_intersector = [&](const uint32_t *prims, uint32_t count) {
+                        leaf_intersector(packet.ray(lane), prims, count);
+                    };
+                    intersect_subtree(packet.ray(lane), current, lane_intersector);
+                    packet.update(lane);
+                }
+            }
+        } else if (hit && node.prim_num == 0) {
+            // visit the near child first, push the far one with the rays that reached this node
+            if (packet.dir_is_neg(node.axis)) {
+                stack[top++] = Entry{current + 1, hit};
+                current = node.offset;
+            } else {
+                stack[top++] = Entry{node.offset, hit};
+                current = current + 1;
+            }
+            active = hit;
+            continue;
+        } else if (hit) {
+            for (unsigned lane = 0; lane < packet.size(); ++lane) {
+                if (hit & (1u << lane)) {
+                    leaf_intersector(packet.ray(lane), &_order[node.offset], node.prim_num);
+                    packet.update(lane);
+                }
+            }
+        }
+        if (top == 0) {
+            break;
+        }
+        --top;
+        current = stack[top].node;
+        active = stack[top].active;
+    }
+    if (RenderStats *stats = packet.stats()) {
+        stats->node_visits += visited;
+    }
+}
+
+}
+
+#endif //RAYTRACER_LINEAR_BVH_H
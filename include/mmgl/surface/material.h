@@ -11,8 +11,8 @@
 namespace mmgl {
 
 /**
- * Class for materials used by surfaces.
- * Public member functions have obvious meanings.
+ * Class for materials used by surfaces, immutable once constructed.
+ * Public member functions have obvious meanings. Derived values are computed by the constructor.
  */
 class Material {
 public:
@@ -21,7 +21,7 @@ public:
              float sr = 0, float sg = 0, float sb = 0,
              float ir = 0, float ig = 0, float ib = 0,
              float r = 0) : _kd{dr, dg, db}, _ks{sr, sg, sb}, _ki{ir, ig, ib},
-                            _r(r) { }
+                            _r(r), _reflective{ir != 0 || ig != 0 || ib != 0} { }
 
 
     inline const Vector &kd() const {
@@ -37,18 +37,23 @@ public:
     }
 
     inline bool isReflective() const {
-        return _ki.x() || _ki.y() || _ki.z();
+        return _reflective;
     }
 
     inline float r() const {
         return _r;
     }
 
+    inline bool operator==(const Material &other) const {
+        return _kd == other._kd && _ks == other._ks && _ki == other._ki && _r == other._r;
+    }
+
 private:
     Vector _kd;
     Vector _ks;
     Vector _ki;
     float _r;
+    bool _reflective;
 };
 
 }
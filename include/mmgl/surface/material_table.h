@@ -0,0 +1,81 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_MATERIAL_TABLE_H
+#define RAYTRACER_MATERIAL_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "mmgl/surface/material.h"
+
+namespace mmgl {
+
+/**
+ * Hash of the parameters compared by Material::operator==.
+ */
+struct MaterialHash {
+    size_t operator()(const Material &material) const;
+};
+
+/**
+ * The materials of a scene, surfaces refer to their entry by index instead of holding a copy.
+ * Equal materials share one entry, so a scene file giving many triangles the same material stores it once.
+ * Entries count the surfaces using them and are reused once none does, so recoloring a surface in every
+ * frame does not grow the table. Entry 0 is the default material and is never freed.
+ */
+class MaterialTable {
+public:
+    MaterialTable() : _materials{Material{}}, _refs{0}, _free{}, _ids{} {
+        _ids.emplace(_materials[0], 0);
+    }
+
+    MaterialTable(const MaterialTable &) = delete;
+
+    MaterialTable &operator=(const MaterialTable &) = delete;
+
+    /**
+     * Index of the entry equal to material, which is added if there is none yet, counted as one more user.
+     * Entries are never moved, references to the one of a surface stay valid while it keeps the material.
+     */
+    uint32_t add(const Material &material);
+
+    /**
+     * Count one more user of entry id, e.g. a copy of a surface.
+     */
+    inline void acquire(uint32_t id) {
+        if (id != 0) {
+            ++_refs[id];
+        }
+    }
+
+    /**
+     * Count one user of entry id less, the entry is freed for the next new material once it has none.
+     */
+    void release(uint32_t id);
+
+    inline const Material &operator[](uint32_t id) const {
+        return _materials[id];
+    }
+
+    /**
+     * Number of entries, including the freed ones.
+     */
+    inline uint32_t size() const {
+        return static_cast<uint32_t>(_materials.size());
+    }
+
+private:
+    std::deque<Material> _materials;
+    std::vector<uint32_t> _refs;    // users of every entry, the default entry is not counted
+    std::vector<uint32_t> _free;
+    std::unordered_map<Material, uint32_t, MaterialHash> _ids;
+};
+
+}
+
+#endif //RAYTRACER_MATERIAL_TABLE_H
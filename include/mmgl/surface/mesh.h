@@ -0,0 +1,68 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_MESH_H
+#define RAYTRACER_MESH_H
+
+#include <vector>
+
+#include "mmgl/surface/linear_bvh.h"
+#include "mmgl/surface/triangle_mesh.h"
+
+namespace mmgl {
+
+/**
+ * Triangle mesh in its own object space, with a bottom-level BVH built once on construction.
+ * A mesh is not rendered by itself, instances place it in the scene and share its triangles and BVH.
+ */
+class Mesh {
+public:
+    /**
+     * Build a mesh from vertex coordinates and vertex indices, three per triangle, as parse_obj_file returns them.
+     * The triangles are stored in leaf order of the BVH, so they can come out in a different order.
+     * @param leaf_size Most triangles in a BVH leaf.
+     */
+    Mesh(const std::vector<float> &verts, const std::vector<int> &tris, unsigned leaf_size = 4);
+
+    /**
+     * Build a mesh over the triangles of a triangle mesh, which is taken over and reordered.
+     */
+    Mesh(TriangleMesh &&triangles, unsigned leaf_size = 4);
+
+    /**
+     * Intersect a ray given in object space with the triangles, same contract as Surface::intersect.
+     * A ray starting on one of the triangles() skips it.
+     */
+    template<Render R>
+    bool intersect(Ray &ray) const;
+
+    /**
+     * Occlusion query of a ray given in object space, see Surface::occluded.
+     */
+    template<Render R>
+    bool occluded(const Ray &ray, float t_max) const;
+
+    inline const BBox &box() const {
+        return _triangles.box();
+    }
+
+    inline size_t size() const {
+        return _triangles.prim_num();
+    }
+
+    inline const TriangleMesh &triangles() const {
+        return _triangles;
+    }
+
+private:
+    void init(unsigned leaf_size);
+
+    TriangleMesh _triangles;
+    LinearBVH _bvh;
+};
+
+}
+
+#endif //RAYTRACER_MESH_H
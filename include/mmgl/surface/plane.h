@@ -0,0 +1,85 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_PLANE_H
+#define RAYTRACER_PLANE_H
+
+
+#include <iostream>
+#include <sstream>
+
+#include "mmgl/surface/surface.h"
+
+namespace mmgl {
+
+/**
+ * Class for infinite planes, the points p with normal . p = d.
+ * Derived from Surface base class. A plane is unbounded, so the scene keeps it out of the BVH and
+ * tests it against every ray, which costs one dot product each.
+ */
+class Plane : public Surface {
+public:
+    Plane(float nx = 0, float ny = 1, float nz = 0, float d = 0);
+
+    Plane(const Vector &normal, float d);
+
+    /**
+     * Intersect the plane itself, also in the bounding box modes since its box is unbounded.
+     */
+    bool intersect(Ray &, const Render &) const;
+
+    bool occluded(const Ray &ray, const Render &flag, uint32_t prim, float t_max) const;
+
+    Vector normal(const Hit &hit, const Point &point) const;
+
+    inline bool bounded() const {
+        return false;
+    }
+
+    std::string to_string() const;
+
+    inline const Vector &normal() const {
+        return _norm;
+    }
+
+    inline float distance() const {
+        return _d;
+    }
+
+    /**
+     * Set the normal, which needs not be normalized, the plane keeps its distance to the origin.
+     */
+    Plane &normal(float nx, float ny, float nz);
+
+    Plane &normal(const Vector &normal);
+
+    /**
+     * Set the signed distance of the plane to the origin along its normal.
+     */
+    Plane &distance(float d);
+
+    /**
+     * Set the material of the plane.
+     */
+    Plane &made_of(const Material &material);
+
+private:
+    /**
+     * Solve for the ray parameter of the hit, false if the ray is parallel to the plane or hits it behind the origin.
+     */
+    bool solve(const Ray &ray, float &t) const;
+
+    /**
+     * Normalize the normal, the box is only bounded along an axis the plane is perpendicular to.
+     */
+    void init();
+
+    Vector _norm;
+    float _d;
+};
+
+}
+
+#endif //RAYTRACER_PLANE_H
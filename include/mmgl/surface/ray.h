@@ -14,6 +14,8 @@
 
 namespace mmgl {
 
+struct RenderStats;
+
 /**
  * Class for rays in ray tracing algorithms.
  * Public member functions have obvious meanings.
@@ -42,28 +44,73 @@ public:
         return _dir;
     }
 
-    inline const Intersection &intersection() const {
-        return _intersection;
+    /**
+     * Closest hit so far, only valid if has_intersect. Surface::intersection turns it into a shading record.
+     */
+    inline const Hit &hit() const {
+        return _hit;
     }
 
     inline bool has_intersect() const {
         return _has_intersect;
     }
 
-    inline void intersection(Intersection &&intersection) {
+    inline void hit(const Hit &hit) {
         _has_intersect = true;
-        _intersection = intersection;
+        _hit = hit;
     }
 
     bool updatable(float t) const;
 
+    /**
+     * Mark the primitive a shadow or reflection ray starts from, surfaces skip it when intersecting.
+     */
+    inline void start_at(const Intersection &intersection) {
+        start_at(intersection.id(), intersection.prim());
+    }
+
+    inline void start_at(const Surface *id, uint32_t prim) {
+        _start_id = id;
+        _start_prim = prim;
+    }
+
+    inline const Surface *start_id() const {
+        return _start_id;
+    }
+
+    inline uint32_t start_prim() const {
+        return _start_prim;
+    }
+
+    /**
+     * Whether the ray starts on the given primitive.
+     */
+    inline bool starts_on(const Surface *id, uint32_t prim = 0) const {
+        return _start_id == id && _start_prim == prim;
+    }
+
     bool has_block(float max) const;
 
+    /**
+     * Counters the intersection tests of this ray go into, nullptr outside of a render.
+     * Rays spawned from it, shadow and reflection rays or the object space ray of an instance, take it over.
+     */
+    inline RenderStats *stats() const {
+        return _stats;
+    }
+
+    inline void stats(RenderStats *stats) {
+        _stats = stats;
+    }
+
 private:
     Point _origin;
     Vector _dir;
     bool _has_intersect;
-    Intersection _intersection; // closest intersection
+    Hit _hit; // closest hit
+    const Surface *_start_id;
+    uint32_t _start_prim;
+    RenderStats *_stats;
 };
 
 std::ostream &operator<<(std::ostream &os, const Ray &ray);
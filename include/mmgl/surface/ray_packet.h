@@ -0,0 +1,127 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_RAY_PACKET_H
+#define RAYTRACER_RAY_PACKET_H
+
+#include <cstdint>
+#include <limits>
+
+#include "mmgl/surface/ray.h"
+
+#define PACKET_WIDTH 4
+#define PACKET_SIZE (PACKET_WIDTH * PACKET_WIDTH)
+#define PACKET_MIN_ACTIVE 4
+
+namespace mmgl {
+
+/**
+ * Kernel slab-testing one box against all PACKET_SIZE rays of a packet, returns the bit mask of the hit lanes.
+ * bounds holds min x/y/z then max x/y/z, the ray data is SoA with one row per axis.
+ */
+using PacketKernel = unsigned (*)(const float *bounds, const float (*orig)[PACKET_SIZE],
+                                  const float (*inv_dir)[PACKET_SIZE], const float *t_max);
+
+/**
+ * Number of lanes set in a mask.
+ */
+inline int lane_num(unsigned mask) {
+    int n = 0;
+    for (; mask; mask &= mask - 1) {
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * Up to PACKET_SIZE coherent rays, e.g. the primary rays of a PACKET_WIDTH x PACKET_WIDTH pixel tile,
+ * traced through the BVH together. Origins and inverse directions are kept SoA, so a node is tested
+ * against all rays by one SIMD kernel call. When all directions agree in sign, the packet also keeps
+ * the bounds of its origins and inverse directions, and interval arithmetic culls whole nodes at once.
+ */
+class RayPacket {
+public:
+    RayPacket() : _num{0}, _coherent{false} { }
+
+    /**
+     * Append a ray, at most PACKET_SIZE of them.
+     */
+    void add(const Ray &ray);
+
+    /**
+     * Compute the packet bounds once all rays are added.
+     */
+    void finish();
+
+    inline unsigned size() const {
+        return _num;
+    }
+
+    inline Ray &ray(unsigned lane) {
+        return _rays[lane];
+    }
+
+    /**
+     * Counters of the rays, all lanes count into the same ones.
+     */
+    inline RenderStats *stats() const {
+        return _rays[0].stats();
+    }
+
+    /**
+     * Mask of all used lanes.
+     */
+    inline unsigned mask() const {
+        return (1u << _num) - 1;
+    }
+
+    /**
+     * Whether all directions are non-zero and have the same sign on every axis, which interval culling needs.
+     */
+    inline bool coherent() const {
+        return _coherent;
+    }
+
+    /**
+     * Direction sign on an axis, the near child of a node is taken from the first ray.
+     */
+    inline bool dir_is_neg(int axis) const {
+        return _inv_dir[axis][0] < 0;
+    }
+
+    /**
+     * Pick up the closest hit of a lane after its ray was intersected, it prunes the following nodes.
+     */
+    inline void update(unsigned lane) {
+        if (_rays[lane].has_intersect()) {
+            _t_max[lane] = _rays[lane].hit().t;
+        }
+    }
+
+    /**
+     * Conservative test of a box against the whole packet, true only if no ray can hit it.
+     * Only meaningful for coherent packets.
+     */
+    bool misses(const float *min, const float *max) const;
+
+    /**
+     * Slab test of a box against the rays in active, same result per ray as a single ray node test.
+     */
+    unsigned intersect(const float *min, const float *max, unsigned active) const;
+
+private:
+    Ray _rays[PACKET_SIZE];
+    float _orig[3][PACKET_SIZE];
+    float _inv_dir[3][PACKET_SIZE];
+    float _t_max[PACKET_SIZE];
+    float _orig_lo[3], _orig_hi[3];
+    float _inv_lo[3], _inv_hi[3];
+    unsigned _num;
+    bool _coherent;
+};
+
+}
+
+#endif //RAYTRACER_RAY_PACKET_H
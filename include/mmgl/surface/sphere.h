@@ -24,8 +24,31 @@ public:
 
     Sphere(const Point &origin, float radius);
 
+    /**
+     * Picks the kernel for the Render mode once, see intersect<R>.
+     */
     bool intersect(Ray &, const Render &) const;
 
+    /**
+     * Intersect with the Render mode fixed at compile time, the camera calls this one from its leaf loops.
+     */
+    template<Render R>
+    bool intersect(Ray &ray) const;
+
+    /**
+     * Occlusion query, solves for t only.
+     */
+    bool occluded(const Ray &ray, const Render &flag, uint32_t prim, float t_max) const;
+
+    template<Render R>
+    bool occluded(const Ray &ray, float t_max) const;
+
+    Vector normal(const Hit &hit, const Point &point) const;
+
+    inline PrimType prim_type() const {
+        return PrimType::SPHERE;
+    }
+
     std::string to_string() const;
 
     inline const Point &origin() const {
@@ -59,6 +82,11 @@ public:
     Sphere &made_of(const Material &material);
 
 private:
+    /**
+     * Solve for the ray parameter of the nearer hit, false if the ray misses the sphere or it lies behind the origin.
+     */
+    bool solve(const Ray &ray, float &t) const;
+
     void init() {
         float x_min, y_min, z_min, x_max, y_max, z_max;
         x_min = _origin._x - _radius;
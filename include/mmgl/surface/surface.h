@@ -9,32 +9,91 @@
 #include <string>
 #include <iostream>
 
-#include "mmgl/surface/material.h"
+#include "mmgl/surface/material_table.h"
 #include "mmgl/surface/ray.h"
 #include "mmgl/surface/bbox.h"
 #include "mmgl/util/common.h"
 
 namespace mmgl {
 
+class Surface;
+
+/**
+ * Type tag of a primitive. The camera intersects spheres, triangles, triangle meshes and instances
+ * through their kernels templated on the Render mode, the primitives of other surfaces go through
+ * the virtual Surface interface.
+ */
+enum class PrimType : uint8_t {
+    SURFACE = 0,
+    SPHERE = 1,
+    TRIANGLE = 2,
+    MESH = 3,
+    INSTANCE = 4
+};
+
+/**
+ * Interface for being told that the geometry of a surface changed, e.g. by the scene owning it.
+ */
+class SurfaceListener {
+public:
+    virtual void surface_changed(const Surface &surface) = 0;
+
+    virtual ~SurfaceListener() { }
+};
+
 /**
  * Abstract base class for all kinds of surfaces.
  * Public member functions have obvious meanings as their names indicate.
  */
 class Surface {
 public:
-    virtual ~Surface() { }
+    Surface() = default;
+
+    /**
+     * Copies count as one more user of the material entry.
+     */
+    Surface(const Surface &other);
 
+    Surface &operator=(const Surface &other);
+
+    virtual ~Surface();
+
+    /**
+     * The material, looked up in the table of the scene owning this surface.
+     * A surface that is not in a scene keeps its material in a table shared by all such surfaces.
+     */
     inline const Material &material() const {
-        return _material;
+        return (*_materials)[_material];
     }
 
-    inline void material(const Material &_material) {
-        Surface::_material = _material;
+    /**
+     * Set the material, which is added to the material table of the scene. The entry of the previous
+     * material is released first, a new material takes it over if no other surface used it.
+     */
+    void material(const Material &material);
+
+    /**
+     * Index of the material in the scene's material table.
+     */
+    inline uint32_t material_id() const {
+        return _material;
     }
 
+    /**
+     * Attach the material table of the scene owning this surface, or the shared one if materials is null.
+     * The entry of the previous material is released and the material is reset to the default.
+     */
+    void materials(MaterialTable *materials);
+
+    /**
+     * Set the bounding box. Every geometry change goes through here, so the listener is notified.
+     */
     inline void box(float x_min, float y_min, float z_min,
                     float x_max, float y_max, float z_max) {
         _box.box(x_min, y_min, z_min, x_max, y_max, z_max);
+        if (_listener) {
+            _listener->surface_changed(*this);
+        }
     }
 
     inline const BBox &box() const {
@@ -51,15 +110,142 @@ public:
 
     virtual bool intersect(Ray &, const Render &) const = 0;
 
+    /**
+     * Unit normal at point of a hit on this surface, only asked for the closest hit of a ray.
+     */
+    virtual Vector normal(const Hit &hit, const Point &point) const = 0;
+
+    /**
+     * Shading record of the closest hit of ray, which must be on this surface. Traversal only keeps t,
+     * the primitive and barycentrics, the point and normal are derived here once per ray.
+     * The bounding box modes take the normal of the primitive's box instead, if it has a finite one.
+     */
+    Intersection intersection(const Ray &ray, const Render &flag) const;
+
+    /**
+     * Whether the surface has a finite box. Unbounded ones, like planes, are kept out of the scene BVH
+     * and tested against every ray instead.
+     */
+    virtual bool bounded() const {
+        return true;
+    }
+
+    /**
+     * Type tag of the primitives of this surface.
+     */
+    virtual PrimType prim_type() const {
+        return PrimType::SURFACE;
+    }
+
+    /**
+     * Number of primitives the scene BVH indexes in this surface, a surface is a single primitive by default.
+     */
+    virtual uint32_t prim_num() const {
+        return 1;
+    }
+
+    /**
+     * Bounding box of one primitive.
+     */
+    virtual BBox prim_box(uint32_t) const {
+        return _box;
+    }
+
+    /**
+     * Intersect one primitive only, same contract as intersect(Ray &, const Render &).
+     */
+    virtual bool intersect(Ray &ray, const Render &flag, uint32_t) const {
+        return intersect(ray, flag);
+    }
+
+    /**
+     * Intersect several primitives of this surface, given by index, e.g. those of one BVH leaf.
+     * Returns whether any of them was hit, surfaces with a vectorized test override it.
+     */
+    virtual bool intersect_batch(Ray &ray, const Render &flag, const uint32_t *prims, uint32_t count) const {
+        bool hit = false;
+        for (uint32_t i = 0; i < count; ++i) {
+            hit = intersect(ray, flag, prims[i]) || hit;
+        }
+        return hit;
+    }
+
+    /**
+     * Whether one primitive blocks the ray somewhere in (EPS, t_max), the occlusion query of shadow rays.
+     * It finds the same hits as intersect but records none. The default intersects a copy of the ray,
+     * surfaces override it to skip the hit point and normal.
+     */
+    virtual bool occluded(const Ray &ray, const Render &flag, uint32_t prim, float t_max) const;
+
+    /**
+     * Occlusion query over several primitives of this surface, stops at the first one blocking the ray.
+     */
+    virtual bool occluded_batch(const Ray &ray, const Render &flag, const uint32_t *prims, uint32_t count,
+                                float t_max) const {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (occluded(ray, flag, prims[i], t_max)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Bounds of the part of the surface inside bounds, used by spatial BVH splits.
+     * The default clips the bounding box, surfaces with a tighter answer override it.
+     */
+    virtual BBox clip(const BBox &bounds) const {
+        return _box.overlap(bounds);
+    }
+
+    /**
+     * Bounds of the part of one primitive inside bounds.
+     */
+    virtual BBox prim_clip(uint32_t, const BBox &bounds) const {
+        return clip(bounds);
+    }
+
     virtual std::string to_string() const = 0;
 
+    inline void listener(SurfaceListener *listener) {
+        _listener = listener;
+    }
+
+    /**
+     * Position of the surface in the SurfaceStore holding it, so the store frees it without searching.
+     */
+    inline uint32_t slot() const {
+        return _slot;
+    }
+
+    inline void slot(uint32_t slot) {
+        _slot = slot;
+    }
+
 private:
-    Material _material;
+    /**
+     * Table of the surfaces not in a scene, like the scene API it is not safe to change from several threads.
+     */
+    static MaterialTable &standalone_materials();
+
+    MaterialTable *_materials = &standalone_materials();
+    uint32_t _material = 0;
+    uint32_t _slot = 0;
     BBox _box;
+    SurfaceListener *_listener = nullptr;
 };
 
 std::ostream &operator<<(std::ostream &os, const Surface &surface);
 
+/**
+ * One primitive of a surface, the scene BVH is built over these.
+ */
+struct Primitive {
+    const Surface *surface;
+    uint32_t index;
+    PrimType type;
+};
+
 }
 
 #endif //RAYTRACER_SURFACE_H
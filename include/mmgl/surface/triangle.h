@@ -27,8 +27,39 @@ public:
 
     Triangle(const Point &p1, const Point &p2, const Point &p3);
 
+    /**
+     * Picks the kernel for the Render mode once, see intersect<R>.
+     */
     bool intersect(Ray &, const Render &) const;
 
+    /**
+     * Intersect with the Render mode fixed at compile time, the camera calls this one from its leaf loops.
+     */
+    template<Render R>
+    bool intersect(Ray &ray) const;
+
+    /**
+     * Occlusion query, solves for t only.
+     */
+    bool occluded(const Ray &ray, const Render &flag, uint32_t prim, float t_max) const;
+
+    template<Render R>
+    bool occluded(const Ray &ray, float t_max) const;
+
+    /**
+     * The cached unit normal, the same everywhere on the triangle.
+     */
+    Vector normal(const Hit &hit, const Point &point) const;
+
+    inline PrimType prim_type() const {
+        return PrimType::TRIANGLE;
+    }
+
+    /**
+     * Clip the triangle itself against bounds, much tighter than the box for large slanted triangles.
+     */
+    BBox clip(const BBox &bounds) const;
+
     std::string to_string() const;
 
     Triangle &point_one(const Point &p1);
@@ -46,6 +77,12 @@ public:
     Triangle &made_of(const Material &material);
 
 private:
+    /**
+     * Solve for the ray parameter and the barycentrics of the second and third point of the hit,
+     * false if the ray misses the triangle or hits it behind the origin.
+     */
+    bool solve(const Ray &ray, float &t, float &beta, float &gamma) const;
+
     void init() {
         Vector p12 = _p2 - _p1;
         Vector p13 = _p3 - _p1;
@@ -79,6 +116,12 @@ private:
     float _a, _b, _c, _d, _e, _f;
 };
 
+/**
+ * Bounds of the part of triangle p1 p2 p3 inside bounds, padded like a surface box.
+ * Clipping the triangle itself is much tighter than clipping its box for large slanted triangles.
+ */
+BBox clip_triangle(const Point &p1, const Point &p2, const Point &p3, const BBox &bounds);
+
 }
 
 #endif //RAYTRACER_TRIANGLE_H
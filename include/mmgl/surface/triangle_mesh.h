@@ -0,0 +1,161 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_TRIANGLE_MESH_H
+#define RAYTRACER_TRIANGLE_MESH_H
+
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+#include "mmgl/surface/surface.h"
+
+#define TRIANGLE_BATCH 8
+#define TRIANGLE_T_MIN 0.00005f
+
+namespace mmgl {
+
+/**
+ * Kernel intersecting a ray with TRIANGLE_BATCH triangles at once, Moller-Trumbore without the division.
+ * tri holds nine rows, stride floats apart: the first vertex x/y/z, then the edges to the second and the
+ * third vertex. Returns the bit mask of the hits before t_max and writes t * |det|, |det| and the two
+ * barycentrics times |det| of every lane, so only the nearest hit needs a division.
+ */
+using TriangleKernel = unsigned (*)(const float *tri, int stride, const float *orig, const float *dir,
+                                    float t_max, float *t_num, float *det, float *u_num, float *v_num);
+
+/**
+ * Class for triangle meshes, the vertex positions are shared by the triangles and kept in one array
+ * per coordinate, every triangle is three 32-bit vertex indices. The whole mesh has a single material.
+ * Derived from Surface base class, the scene BVH indexes the triangles of a mesh one by one.
+ * The first vertex and the two edges of every triangle are also kept SoA, the batched intersection
+ * tests TRIANGLE_BATCH triangles per SSE or AVX2 kernel call, picked once from the CPU.
+ */
+class TriangleMesh : public Surface {
+public:
+    /**
+     * Take over vertex coordinates and vertex indices, three per triangle.
+     * @throw RenderException if there is no triangle or an index is out of range.
+     */
+    TriangleMesh(std::vector<float> &&xs, std::vector<float> &&ys, std::vector<float> &&zs,
+                 std::vector<uint32_t> &&indices);
+
+    /**
+     * Intersect all triangles as batches, used by the brute-force render modes.
+     */
+    bool intersect(Ray &, const Render &) const;
+
+    /**
+     * Intersect one triangle through the batch kernel, a single lane loaded straight from the edge arrays.
+     * The hit has this mesh as id and the triangle index as prim.
+     */
+    bool intersect(Ray &, const Render &, uint32_t triangle) const;
+
+    /**
+     * Intersect one triangle with the Render mode fixed at compile time, called from the leaf loops of the camera.
+     */
+    template<Render R>
+    bool intersect(Ray &ray, uint32_t triangle) const;
+
+    /**
+     * Unit normal of the hit triangle, the cross product of its edges.
+     */
+    Vector normal(const Hit &hit, const Point &point) const;
+
+    /**
+     * Intersect the given triangles TRIANGLE_BATCH at a time. A run of consecutive indices is loaded
+     * straight from the edge arrays, others are gathered. Hits behind the closest one are not reported.
+     */
+    bool intersect_batch(Ray &ray, const Render &flag, const uint32_t *triangles, uint32_t count) const;
+
+    template<Render R>
+    bool intersect_batch(Ray &ray, const uint32_t *triangles, uint32_t count) const;
+
+    /**
+     * Occlusion query of one triangle, through the same kernel as the batches.
+     */
+    bool occluded(const Ray &ray, const Render &flag, uint32_t triangle, float t_max) const;
+
+    /**
+     * Occlusion query of the given triangles, TRIANGLE_BATCH at a time, stops at the first batch blocking the ray.
+     */
+    bool occluded_batch(const Ray &ray, const Render &flag, const uint32_t *triangles, uint32_t count,
+                        float t_max) const;
+
+    template<Render R>
+    bool occluded_batch(const Ray &ray, const uint32_t *triangles, uint32_t count, float t_max) const;
+
+    inline PrimType prim_type() const {
+        return PrimType::MESH;
+    }
+
+    inline uint32_t prim_num() const {
+        return static_cast<uint32_t>(_indices.size() / 3);
+    }
+
+    BBox prim_box(uint32_t triangle) const;
+
+    BBox prim_clip(uint32_t triangle, const BBox &bounds) const;
+
+    /**
+     * Vertex of a triangle, 0, 1 or 2.
+     */
+    inline Point vertex(uint32_t triangle, int corner) const {
+        uint32_t v = _indices[3 * triangle + corner];
+        return Point{_xs[v], _ys[v], _zs[v]};
+    }
+
+    /**
+     * Reorder the triangles so that the new triangle i is the old triangle order[i].
+     */
+    void reorder(const std::vector<uint32_t> &order);
+
+    std::string to_string() const;
+
+    TriangleMesh &made_of(const Material &material);
+
+private:
+    /**
+     * Fill the SoA edge arrays from the vertices, the padding lanes are degenerate and never hit.
+     */
+    void init_edges();
+
+    /**
+     * Closest hit of the box of one triangle, what the bounding box modes draw.
+     */
+    bool box_hit(Ray &ray, uint32_t triangle) const;
+
+    /**
+     * Whether the box of one triangle blocks the ray in (EPS, t_max).
+     */
+    bool box_blocks(const Ray &ray, uint32_t triangle, float t_max) const;
+
+    /**
+     * Closest hit among triangles[0, count), or the range [first, first + count) if triangles is null.
+     */
+    bool nearest_hit(Ray &ray, const uint32_t *triangles, uint32_t first, uint32_t count) const;
+
+    /**
+     * Whether any of the triangles is hit in (EPS, t_max), same selection as nearest_hit.
+     */
+    bool any_hit(const Ray &ray, const uint32_t *triangles, uint32_t first, uint32_t count, float t_max) const;
+
+    /**
+     * Edge data of the n triangles starting at position k of triangles, or at triangle k if triangles is null.
+     * Points into the SoA arrays for consecutive triangles, otherwise gathers them into gathered.
+     */
+    const float *batch(const uint32_t *triangles, uint32_t k, uint32_t n, float *gathered, int &stride) const;
+
+    std::vector<float> _xs;
+    std::vector<float> _ys;
+    std::vector<float> _zs;
+    std::vector<uint32_t> _indices;
+    std::vector<float> _edges;  // 9 rows of _stride floats, see TriangleKernel
+    uint32_t _stride;
+};
+
+}
+
+#endif //RAYTRACER_TRIANGLE_MESH_H
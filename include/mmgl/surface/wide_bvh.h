@@ -0,0 +1,243 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_WIDE_BVH_H
+#define RAYTRACER_WIDE_BVH_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "mmgl/surface/linear_bvh.h"
+
+#define WIDE_BVH_STACK_SIZE (BVH_STACK_SIZE * 7)
+
+namespace mmgl {
+
+/**
+ * Node of a wide BVH with up to N children. Child boxes are laid out SoA, one lane per child,
+ * so a single SIMD kernel slab-tests all of them at once.
+ */
+template<int N>
+struct WideBVHNode {
+    float bounds[6][N]; // min x/y/z then max x/y/z of every child
+    uint32_t child[N];  // interior child: node index, leaf child: first position in the primitive order
+    uint32_t count[N];  // number of primitives of a leaf child, 0 for interior children
+    uint32_t valid;     // bit mask of the used child slots
+};
+
+/**
+ * Kernel testing all N child boxes of a node against a ray, returns the bit mask of hit children
+ * and writes the entry distance of every lane to t_near.
+ */
+using WideKernel = unsigned (*)(const float *bounds, const float *orig, const float *inv_dir,
+                                float t_max, float *t_near);
+
+/**
+ * 4-wide (QBVH) or 8-wide (OBVH) BVH, collapsed from a binary LinearBVH.
+ * The child box kernel is picked once per build from SSE, AVX2 or scalar code, depending on the CPU.
+ */
+class WideBVH {
+public:
+    WideBVH() : _width{4}, _nodes4{}, _nodes8{}, _order{}, _lane_of{}, _kernel{nullptr} { }
+
+    /**
+     * Collapse a binary tree into nodes of width 4 or 8, leaves keep the primitive ranges of the binary tree.
+     */
+    void build(const LinearBVH &bvh, unsigned width);
+
+    void clear();
+
+    /**
+     * Copy the bounds of refitted binary nodes into the lanes they were collapsed into.
+     * @param updated Node indices reported by LinearBVH::refit.
+     */
+    void refit(const LinearBVH &bvh, const std::vector<uint32_t> &updated);
+
+    inline bool empty() const {
+        return _order.empty();
+    }
+
+    inline unsigned width() const {
+        return _width;
+    }
+
+    inline size_t node_num() const {
+        return _width == 4 ? _nodes4.size() : _nodes8.size();
+    }
+
+    /**
+     * Bytes held by the nodes and index arrays.
+     */
+    inline size_t memory() const {
+        return _nodes4.capacity() * sizeof(WideBVHNode<4>) + _nodes8.capacity() * sizeof(WideBVHNode<8>) +
+               (_order.capacity() + _lane_of.capacity()) * sizeof(uint32_t);
+    }
+
+    /**
+     * Same contract as LinearBVH::intersect.
+     */
+    template<typename Intersector>
+    void intersect(Ray &ray, Intersector &&intersector) const {
+        intersect_leaves(ray, [&](const uint32_t *prims, uint32_t count) {
+            for (uint32_t i = 0; i < count; ++i) {
+                intersector(prims[i]);
+            }
+        });
+    }
+
+    /**
+     * Same contract as LinearBVH::intersect_leaves.
+     */
+    template<typename LeafIntersector>
+    void intersect_leaves(Ray &ray, LeafIntersector &&leaf_intersector) const {
+        if (_width == 4) {
+            intersect_leaves(_nodes4, ray, leaf_intersector);
+        } else {
+            intersect_leaves(_nodes8, ray, leaf_intersector);
+        }
+    }
+
+    /**
+     * Same contract as LinearBVH::occluded.
+     */
+    template<typename LeafOccluder>
+    bool occluded(const Ray &ray, float t_max, LeafOccluder &&leaf_occluder) const {
+        if (_width == 4) {
+            return occluded(_nodes4, ray, t_max, leaf_occluder);
+        } else {
+            return occluded(_nodes8, ray, t_max, leaf_occluder);
+        }
+    }
+
+private:
+    template<int N>
+    uint32_t collapse(const LinearBVH &bvh, uint32_t index, std::vector<WideBVHNode<N>> &nodes);
+
+    template<int N, typename LeafIntersector>
+    void intersect_leaves(const std::vector<WideBVHNode<N>> &nodes, Ray &ray, LeafIntersector &leaf_intersector) const;
+
+    template<int N, typename LeafOccluder>
+    bool occluded(const std::vector<WideBVHNode<N>> &nodes, const Ray &ray, float t_max,
+                  LeafOccluder &leaf_occluder) const;
+
+    template<int N>
+    void refit(const LinearBVH &bvh, const std::vector<uint32_t> &updated, std::vector<WideBVHNode<N>> &nodes);
+
+    unsigned _width;
+    std::vector<WideBVHNode<4>> _nodes4;
+    std::vector<WideBVHNode<8>> _nodes8;
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _lane_of; // binary node -> wide node * 8 + lane, UINT32_MAX if collapsed away
+    WideKernel _kernel;
+};
+
+template<int N, typename LeafIntersector>
+void WideBVH::intersect_leaves(const std::vector<WideBVHNode<N>> &nodes, Ray &ray,
+                               LeafIntersector &leaf_intersector) const {
+    if (nodes.empty()) {
+        return;
+    }
+
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float inv_dir[3] = {1.0f / ray.dir().x(), 1.0f / ray.dir().y(), 1.0f / ray.dir().z()};
+
+    struct Entry {
+        uint32_t node;
+        float t;
+    };
+    Entry stack[WIDE_BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = Entry{0, -std::numeric_limits<float>::infinity()};
+    uint64_t visited = 0;
+
+    while (top > 0) {
+        const Entry entry = stack[--top];
+        if (ray.has_intersect() && entry.t > ray.hit().t) {
+            continue;
+        }
+
+        const WideBVHNode<N> &node = nodes[entry.node];
+        ++visited;
+        float t_max = ray.has_intersect() ? ray.hit().t : std::numeric_limits<float>::infinity();
+        float t_near[N];
+        unsigned mask = _kernel(node.bounds[0], orig, inv_dir, t_max, t_near) & node.valid;
+        if (!mask) {
+            continue;
+        }
+
+        // order the hit children near-to-far
+        int lanes[N];
+        int hit_num = 0;
+        for (int lane = 0; lane < N; ++lane) {
+            if (mask & (1u << lane)) {
+                int k = hit_num++;
+                for (; k > 0 && t_near[lanes[k - 1]] > t_near[lane]; --k) {
+                    lanes[k] = lanes[k - 1];
+                }
+                lanes[k] = lane;
+            }
+        }
+
+        // leaves right away, interior children pushed far-to-near so the nearest one pops first
+        for (int k = 0; k < hit_num; ++k) {
+            int lane = lanes[k];
+            if (node.count[lane]) {
+                leaf_intersector(&_order[node.child[lane]], node.count[lane]);
+            }
+        }
+        for (int k = hit_num - 1; k >= 0; --k) {
+            int lane = lanes[k];
+            if (node.count[lane] == 0) {
+                stack[top++] = Entry{node.child[lane], t_near[lane]};
+            }
+        }
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->node_visits += visited;
+    }
+}
+
+template<int N, typename LeafOccluder>
+bool WideBVH::occluded(const std::vector<WideBVHNode<N>> &nodes, const Ray &ray, float t_max,
+                       LeafOccluder &leaf_occluder) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float inv_dir[3] = {1.0f / ray.dir().x(), 1.0f / ray.dir().y(), 1.0f / ray.dir().z()};
+
+    // any hit ends the query, so children are neither sorted nor pruned by their entry distance
+    uint32_t stack[WIDE_BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    uint64_t visited = 0;
+    bool blocked = false;
+    while (top > 0 && !blocked) {
+        const WideBVHNode<N> &node = nodes[stack[--top]];
+        ++visited;
+        float t_near[N];
+        unsigned mask = _kernel(node.bounds[0], orig, inv_dir, t_max, t_near) & node.valid;
+        for (int lane = 0; lane < N && !blocked; ++lane) {
+            if (!(mask & (1u << lane))) {
+                continue;
+            }
+            if (node.count[lane] == 0) {
+                stack[top++] = node.child[lane];
+            } else {
+                blocked = leaf_occluder(&_order[node.child[lane]], node.count[lane]);
+            }
+        }
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->node_visits += visited;
+    }
+    return blocked;
+}
+
+}
+
+#endif //RAYTRACER_WIDE_BVH_H
@@ -6,6 +6,7 @@
 #ifndef RAYTRACER_COMMON_H
 #define RAYTRACER_COMMON_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -33,12 +34,28 @@ enum class Render {
     BVH = 3             /** BVH structure for acceleration */
 };
 
+/**
+ * Whether a Render mode draws the bounding boxes of the primitives instead of the primitives.
+ * The kernels called from the camera take the mode as template argument, so this folds away there.
+ */
+template<Render R>
+constexpr bool box_only() {
+    return R == Render::BBOX_ONLY || R == Render::BVH_BBOX_ONLY;
+}
+
+inline bool box_only(Render flag) {
+    return flag == Render::BBOX_ONLY || flag == Render::BVH_BBOX_ONLY;
+}
+
 /**
  * BVH options.
  */
 enum class BVH {
     VOLUME_CUT = 0,     /** Volume cut option for BVH tree */
-    COUNT_CUT = 1       /** Count cut option for BVH tree */
+    COUNT_CUT = 1,      /** Count cut option for BVH tree */
+    SAH = 2,            /** Binned surface area heuristic for BVH tree */
+    LBVH = 3,           /** Linear BVH from sorted Morton codes, fastest build */
+    SBVH = 4            /** SAH with spatial splits, large primitives are clipped into several leaves */
 };
 
 /**
@@ -47,13 +64,30 @@ enum class BVH {
 enum class ParallelMethod {
     STD_ASYNC,          /** use std::async */
     STD_ASYNC_FORCE,    /** use std::async with std::launch::async */
-    THREAD_POOL         /** use customized thread pool */
+    THREAD_POOL,        /** use customized thread pool */
+    WORK_STEALING,      /** use the thread pool with per-worker work-stealing deques */
+    TILE_COUNTER        /** one worker per thread of the pool takes tiles off an atomic counter, no partitions */
+};
+
+/**
+ * Order in which the image is handed out to the render partitions.
+ */
+enum class TileOrder {
+    LINEAR,             /** row-major 4x4 pixel blocks, a partition is a thin horizontal strip */
+    MORTON              /** tiles of SceneConfig::tile_size in Z order, blocks and pixels inside a tile too */
 };
 
 float get_token_as_float(std::string inString, int whichToken);
 
 void parse_obj_file(const std::string &file, std::vector<int> &tris, std::vector<float> &verts);
 
+/**
+ * Parse an OBJ file straight into the layout of TriangleMesh, one array per vertex coordinate
+ * and three 32-bit vertex indices per triangle.
+ */
+void parse_obj_file(const std::string &file, std::vector<uint32_t> &indices,
+                    std::vector<float> &xs, std::vector<float> &ys, std::vector<float> &zs);
+
 // float rand_float();
 
 }
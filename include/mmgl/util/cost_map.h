@@ -0,0 +1,84 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_COST_MAP_H
+#define RAYTRACER_COST_MAP_H
+
+#include <iostream>
+#include <vector>
+
+namespace mmgl {
+
+/**
+ * Wall time of the last render, per 4x4 pixel block of the image and per task the image was split into.
+ * The camera balances the tasks of the next render by the block times, see SceneConfig::adaptive_partitions.
+ */
+class CostMap {
+public:
+    CostMap() : _width{0}, _height{0} { }
+
+    /**
+     * Start over with a width x height grid of blocks, all costs zero.
+     */
+    void reset(int width, int height);
+
+    /**
+     * Width of the image in blocks.
+     */
+    inline int width() const {
+        return _width;
+    }
+
+    /**
+     * Height of the image in blocks.
+     */
+    inline int height() const {
+        return _height;
+    }
+
+    /**
+     * Milliseconds spent on the block in column x and row y.
+     */
+    inline float block(int x, int y) const {
+        return _blocks[static_cast<size_t>(y) * _width + x];
+    }
+
+    inline void block(int x, int y, float ms) {
+        _blocks[static_cast<size_t>(y) * _width + x] = ms;
+    }
+
+    /**
+     * Milliseconds spent on each partition, or each task taken off the counter with ParallelMethod::TILE_COUNTER.
+     */
+    inline const std::vector<float> &tasks() const {
+        return _tasks;
+    }
+
+    inline std::vector<float> &tasks() {
+        return _tasks;
+    }
+
+    /**
+     * Sum of all block times.
+     */
+    float total() const;
+
+    /**
+     * The slowest task over the average task, 1 if all tasks took the same time.
+     */
+    float imbalance() const;
+
+private:
+    int _width;
+    int _height;
+    std::vector<float> _blocks;
+    std::vector<float> _tasks;
+};
+
+std::ostream &operator<<(std::ostream &os, const CostMap &costs);
+
+}
+
+#endif //RAYTRACER_COST_MAP_H
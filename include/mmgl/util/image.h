@@ -21,7 +21,7 @@ namespace mmgl {
  */
 class Image {
 public:
-    Image(): _image{} {}
+    Image(): _width{0}, _height{0}, _image{} {}
 
     Image(int width, int height);
 
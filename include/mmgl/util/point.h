@@ -48,6 +48,13 @@ public:
         _z = z;
     }
 
+    /**
+     * Access a coordinate by axis index, 0 for x, 1 for y and 2 for z.
+     */
+    inline float operator[](int axis) const {
+        return axis == 0 ? _x : (axis == 1 ? _y : _z);
+    }
+
     Point(float x = 0, float y = 0, float z = 0);
 
 private:
@@ -27,18 +27,29 @@ public:
      *
      * @param _render_flag Render options, use BVM or other algorihtms.
      * @param _bvh_mode BVH options.
+     * @param _bvh_width Children per BVH node, 2 for the binary tree, 4 or 8 for the SIMD wide tree.
+     * @param _leaf_size Most surfaces in a BVH leaf, BVH::SAH and BVH::SBVH keep fewer where splitting is cheaper.
+     *                   One per leaf by default, a few let the triangle mesh kernel test a leaf as one batch.
+     * @param _refit_threshold Rebuild instead of refitting the BVH once its SAH cost grew by this factor, 0 always refits.
+     * @param _packet_tracing Trace the primary rays of every 4x4 pixel tile as one packet in the BVH render modes.
      * @param _pixel_sampling_num Pixel sampling number. Larger number gives better effect.
      * @param _shadow_sampling_num Shadow sampling number. Larger number gives better effect.
      * @param _recursive_limit Recursive limit used in ray tracing. Larger number gives better effect.
      * @param _thread_num Number of threads used in the thread_pool.
      * @param _partition_num Number of logical partitions used.
      * @param _parallel_method Which parallel method to use.
+     * @param _tile_order Order the pixels are handed out to the partitions in.
+     * @param _tile_width Tile width in pixels for TileOrder::MORTON, rounded up to a multiple of 4.
+     * @param _tile_height Tile height in pixels for TileOrder::MORTON, rounded up to a multiple of 4.
+     * @param _adaptive_partitions Balance the partitions by the block times of the last render of the same size.
      * @param _logging Enable logging or not.
      */
-    SceneConfig() : _render_flag{Render::BVH}, _bvh_mode{BVH::VOLUME_CUT},
-                    _pixel_sampling_num{2}, _shadow_sampling_num{2}, _recursive_limit{5},
+    SceneConfig() : _render_flag{Render::BVH}, _bvh_mode{BVH::VOLUME_CUT}, _bvh_width{2}, _leaf_size{1},
+                    _refit_threshold{1.5f}, _packet_tracing{true}, _pixel_sampling_num{2}, _shadow_sampling_num{2},
+                    _recursive_limit{5},
                     _thread_num{std::thread::hardware_concurrency()}, _partition_num{1000},
-                    _parallel_method{ParallelMethod::THREAD_POOL}, _logging{true} { }
+                    _parallel_method{ParallelMethod::THREAD_POOL}, _tile_order{TileOrder::LINEAR},
+                    _tile_width{16}, _tile_height{16}, _adaptive_partitions{true}, _logging{true} { }
 
     unsigned thread_num() const {
         return _thread_num;
@@ -70,6 +81,39 @@ public:
         return *this;
     }
 
+    const TileOrder &tile_order() const {
+        return _tile_order;
+    }
+
+    SceneConfig &tile_order(const TileOrder &tile_order) {
+        _tile_order = tile_order;
+        return *this;
+    }
+
+    unsigned tile_width() const {
+        return _tile_width;
+    }
+
+    unsigned tile_height() const {
+        return _tile_height;
+    }
+
+    SceneConfig &tile_size(unsigned tile_width, unsigned tile_height) {
+        _tile_width = tile_width;
+        _tile_height = tile_height;
+        assert(_tile_width > 0 && _tile_height > 0);
+        return *this;
+    }
+
+    bool adaptive_partitions() const {
+        return _adaptive_partitions;
+    }
+
+    SceneConfig &adaptive_partitions(bool adaptive_partitions) {
+        _adaptive_partitions = adaptive_partitions;
+        return *this;
+    }
+
     const Render &render_flag() const {
         return _render_flag;
     }
@@ -115,6 +159,45 @@ public:
         return *this;
     }
 
+    unsigned bvh_width() const {
+        return _bvh_width;
+    }
+
+    SceneConfig &bvh_width(unsigned bvh_width) {
+        _bvh_width = bvh_width;
+        assert(_bvh_width == 2 || _bvh_width == 4 || _bvh_width == 8);
+        return *this;
+    }
+
+    unsigned leaf_size() const {
+        return _leaf_size;
+    }
+
+    SceneConfig &leaf_size(unsigned leaf_size) {
+        _leaf_size = leaf_size;
+        assert(_leaf_size > 0 && _leaf_size <= 255);
+        return *this;
+    }
+
+    float refit_threshold() const {
+        return _refit_threshold;
+    }
+
+    SceneConfig &refit_threshold(float refit_threshold) {
+        _refit_threshold = refit_threshold;
+        assert(_refit_threshold >= 0);
+        return *this;
+    }
+
+    bool packet_tracing() const {
+        return _packet_tracing;
+    }
+
+    SceneConfig &packet_tracing(bool packet_tracing) {
+        _packet_tracing = packet_tracing;
+        return *this;
+    }
+
     bool logging() const {
         return _logging;
     }
@@ -126,12 +209,20 @@ public:
 private:
     Render _render_flag;
     BVH _bvh_mode;
+    unsigned _bvh_width;
+    unsigned _leaf_size;
+    float _refit_threshold;
+    bool _packet_tracing;
     int _pixel_sampling_num;
     int _shadow_sampling_num;
     int _recursive_limit;
     unsigned _thread_num;
     unsigned _partition_num;
     ParallelMethod _parallel_method;
+    TileOrder _tile_order;
+    unsigned _tile_width;
+    unsigned _tile_height;
+    bool _adaptive_partitions;
     bool _logging;
 };
 
@@ -0,0 +1,32 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef MMGL_SIMD_H
+#define MMGL_SIMD_H
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define MMGL_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace mmgl {
+
+/**
+ * Instruction set extensions the SIMD kernels are dispatched on.
+ */
+enum class SimdLevel {
+    SCALAR = 0,         /** Portable scalar code */
+    SSE = 1,            /** 4-wide SSE2 */
+    AVX2 = 2            /** 8-wide AVX2 */
+};
+
+/**
+ * The best SIMD level supported by the running CPU, detected once and cached.
+ */
+SimdLevel simd_level();
+
+}
+
+#endif //MMGL_SIMD_H
@@ -0,0 +1,54 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_STATS_H
+#define RAYTRACER_STATS_H
+
+#include <cstdint>
+#include <iostream>
+
+namespace mmgl {
+
+/**
+ * Quality and size of a BVH, computed once per build.
+ */
+struct BVHStats {
+    size_t node_num = 0;        /** Nodes of the binary tree */
+    size_t leaf_num = 0;        /** Leaves of the binary tree */
+    size_t reference_num = 0;   /** Primitive references in leaves, above the primitive count with spatial splits */
+    size_t wide_node_num = 0;   /** Nodes of the wide tree, 0 for a width of 2 */
+    int max_depth = 0;          /** Depth of the deepest leaf, the root is at depth 0 */
+    float avg_depth = .0f;      /** Average leaf depth */
+    float sah_cost = .0f;       /** See LinearBVH::sah_cost */
+    size_t memory = 0;          /** Bytes held by the node and index arrays */
+};
+
+std::ostream &operator<<(std::ostream &os, const BVHStats &stats);
+
+/**
+ * Work counters of a render. Every partition counts into its own instance, which its rays carry down to
+ * the kernels, see Ray::stats, and the camera merges them once all partitions are done.
+ */
+struct RenderStats {
+    uint64_t box_tests = 0;         /** BBox::intersect calls */
+    uint64_t triangle_tests = 0;    /** Triangle::intersect calls */
+    uint64_t sphere_tests = 0;      /** Sphere::intersect calls */
+    uint64_t node_visits = 0;       /** BVH nodes visited by all rays */
+    uint64_t primary_rays = 0;
+    uint64_t primary_packets = 0;   /** Packets the primary rays were traced in, 0 without packet tracing */
+    uint64_t primary_nodes = 0;     /** BVH nodes visited by primary rays */
+    uint64_t reflection_rays = 0;
+    uint64_t reflection_nodes = 0;  /** BVH nodes visited by reflection rays */
+    uint64_t shadow_rays = 0;
+    uint64_t shadow_nodes = 0;      /** BVH nodes visited by shadow rays */
+
+    void merge(const RenderStats &other);
+};
+
+std::ostream &operator<<(std::ostream &os, const RenderStats &stats);
+
+}
+
+#endif //RAYTRACER_STATS_H
@@ -8,12 +8,15 @@
 #define RAYTRACER_THREAD_POOL_H
 
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <future>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 namespace mmgl {
 
@@ -81,6 +84,25 @@ public:
                 data_queue.pop();
                 return res;
         }
+        /**
+         * Block until a value is popped or stop is set, returns whether a value was popped.
+         * Whoever sets stop calls wake_all afterwards.
+         */
+        bool wait_and_pop(T& value, const std::atomic_bool& stop) {
+                std::unique_lock<std::mutex> lk(mut);
+                data_cond.wait(lk, [this, &stop]{
+                        return stop || !data_queue.empty();
+                });
+                if(data_queue.empty())
+                        return false;
+                value = std::move(data_queue.front());
+                data_queue.pop();
+                return true;
+        }
+        void wake_all() {
+                std::lock_guard<std::mutex> lk(mut);
+                data_cond.notify_all();
+        }
         bool try_pop(T& value) {
                 std::lock_guard<std::mutex> lk(mut);
                 if(data_queue.empty())
@@ -118,23 +140,107 @@ public:
         }
 };
 
+/**
+ * Blocks wait() until count_down() was called count times, e.g. once by every task of a batch.
+ */
+class countdown_latch {
+        std::mutex mut;
+        std::condition_variable cond;
+        size_t count;
+public:
+        explicit countdown_latch(size_t count_) : count(count_) {}
+        void count_down() {
+                std::lock_guard<std::mutex> lk(mut);
+                if(--count == 0)
+                        cond.notify_all();
+        }
+        void wait() {
+                std::unique_lock<std::mutex> lk(mut);
+                cond.wait(lk, [this]{
+                        return count == 0;
+                });
+        }
+};
+
+/**
+ * Interface shared by the pools, the BVH builders and the camera submit their tasks through it.
+ * A pool only has to queue type-erased tasks and run one of them on request, submit, wait and
+ * parallel_for are built on top of that.
+ */
+class task_pool {
+protected:
+        /**
+         * Queue a task to be run by some thread of the pool.
+         */
+        virtual void push(function_wrapper task) = 0;
+
+public:
+        virtual ~task_pool() {}
+
+        /**
+         * Run one queued task on the calling thread, so a task waiting for its subtasks helps instead of blocking.
+         */
+        virtual void run_pending_task() = 0;
+
+        /**
+         * Number of worker threads of the pool.
+         */
+        virtual unsigned size() const = 0;
+
+        /**
+         * Wait for a future while running pending tasks, safe to call from inside a pool task.
+         */
+        template<typename T>
+        void wait(std::future<T> &f) {
+                while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                        run_pending_task();
+                }
+        }
+
+        /**
+         * Split [begin, end) into chunks of grain and run f(chunk_begin, chunk_end) on each, the calling thread
+         * takes the first chunk and helps with the others until all are done.
+         */
+        template<typename FunctionType>
+        void parallel_for(size_t begin, size_t end, size_t grain, FunctionType f) {
+                std::vector<std::future<void>> futures;
+                for (size_t b = begin + grain; b < end; b += grain) {
+                        size_t e = std::min(b + grain, end);
+                        futures.push_back(submit([=]() { f(b, e); }));
+                }
+                f(begin, std::min(begin + grain, end));
+                for (auto &future : futures) {
+                        wait(future);
+                        future.get();
+                }
+        }
+
+        template<typename FunctionType>
+        std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f) {
+                typedef typename std::result_of<FunctionType()>::type result_type;
+                std::packaged_task<result_type()> task(std::move(f));
+                std::future<result_type> res(task.get_future());
+                push(std::move(task));
+                return res;
+        }
+};
+
 /**
  * Thread pool that provides better control over the number of threads used for rendering.
  * This implementation is based on the book "C++ Concurrency in Action".
  */
-class thread_pool {
+class thread_pool : public task_pool {
         std::atomic_bool done;
         thread_safe_queue<function_wrapper> work_queue;
         std::vector<std::thread> threads;
         join_threads joiner;
 
+        // idle workers block on the queue, a pool kept between renders does not spin
         void worker_thread() {
                 while (!done) {
                         function_wrapper task;
-                        if (work_queue.try_pop(task)) {
+                        if (work_queue.wait_and_pop(task, done)) {
                                 task();
-                        } else {
-                                std::this_thread::yield();
                         }
                 }
         }
@@ -147,21 +253,32 @@ public:
                         }
                 } catch (...) {
                         done = true;
+                        work_queue.wake_all();
                         throw;
                 }
         }
 
         ~thread_pool() {
                 done = true;
+                work_queue.wake_all();
         }
 
-        template<typename FunctionType>
-        std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f) {
-                typedef typename std::result_of<FunctionType()>::type result_type;
-                std::packaged_task<result_type()> task(std::move(f));
-                std::future<result_type> res(task.get_future());
+        unsigned size() const override {
+                return static_cast<unsigned>(threads.size());
+        }
+
+        void run_pending_task() override {
+                function_wrapper task;
+                if (work_queue.try_pop(task)) {
+                        task();
+                } else {
+                        std::this_thread::yield();
+                }
+        }
+
+protected:
+        void push(function_wrapper task) override {
                 work_queue.push(std::move(task));
-                return res;
         }
 };
 
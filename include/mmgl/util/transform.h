@@ -0,0 +1,72 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_TRANSFORM_H
+#define RAYTRACER_TRANSFORM_H
+
+#include <iostream>
+
+#include "mmgl/util/vector.h"
+#include "mmgl/util/exception.h"
+
+namespace mmgl {
+
+/**
+ * Affine transform stored as the upper 3x4 part of a 4x4 matrix.
+ * The chained member functions append a step, so Transform{}.scale(2, 2, 2).translate(1, 0, 0)
+ * first scales and then translates.
+ */
+class Transform {
+public:
+    /**
+     * Identity transform.
+     */
+    Transform();
+
+    Transform &translate(float x, float y, float z);
+
+    Transform &scale(float x, float y, float z);
+
+    /**
+     * Rotate counter-clockwise around an axis through the origin.
+     * @param degrees Rotation angle in degrees.
+     */
+    Transform &rotate(float degrees, float x, float y, float z);
+
+    /**
+     * Compose two transforms, the right hand side is applied first.
+     */
+    Transform operator*(const Transform &rhs) const;
+
+    /**
+     * Inverse transform, throws RenderException if the matrix is singular.
+     */
+    Transform inverse() const;
+
+    Point apply(const Point &point) const;
+
+    /**
+     * Transform a direction, the translation is ignored.
+     */
+    Vector apply(const Vector &vector) const;
+
+    /**
+     * Multiply by the transposed linear part. Called on the inverse transform, this maps normals.
+     */
+    Vector apply_transposed(const Vector &vector) const;
+
+    inline float operator()(int row, int col) const {
+        return _m[row][col];
+    }
+
+private:
+    float _m[3][4];
+};
+
+std::ostream &operator<<(std::ostream &os, const Transform &transform);
+
+}
+
+#endif //RAYTRACER_TRANSFORM_H
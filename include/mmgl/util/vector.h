@@ -89,6 +89,10 @@ Vector operator*(const Vector &lhs, const Vector &rhs);
 
 Vector operator/(const Vector &lhs, float scalar);
 
+inline bool operator==(const Vector &lhs, const Vector &rhs) {
+    return lhs.x() == rhs.x() && lhs.y() == rhs.y() && lhs.z() == rhs.z();
+}
+
 inline Vector operator-(const Point &lhs, const Point &rhs) {
     return std::move(Vector(lhs.x() - rhs.x(), lhs.y() - rhs.y(), lhs.z() - rhs.z()));
 }
@@ -0,0 +1,317 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#ifndef RAYTRACER_WORK_STEALING_POOL_H
+#define RAYTRACER_WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mmgl/util/thread_pool.h"
+
+#define DEQUE_INITIAL_CAPACITY 64
+#define STEAL_ROUNDS 4
+
+namespace mmgl {
+
+/**
+ * Chase-Lev work-stealing deque of task pointers, in the C11 formulation of Le et al.
+ * Only the owning worker pushes and takes at the bottom, any thread may steal from the top.
+ * The ring grows when full, replaced rings are kept until the deque dies since a thief may still read them.
+ */
+class work_stealing_deque {
+public:
+    work_stealing_deque() : _top{0}, _bottom{0} {
+        _rings.emplace_back(new ring(DEQUE_INITIAL_CAPACITY));
+        _ring.store(_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    work_stealing_deque(const work_stealing_deque &) = delete;
+
+    work_stealing_deque &operator=(const work_stealing_deque &) = delete;
+
+    /**
+     * Owner only.
+     */
+    void push(function_wrapper *task) {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_acquire);
+        ring *r = _ring.load(std::memory_order_relaxed);
+        if (b - t > r->size() - 1) {
+            r = grow(r, t, b);
+        }
+        r->put(b, task);
+        // publishes the task to thieves, which load _bottom with acquire
+        _bottom.store(b + 1, std::memory_order_release);
+    }
+
+    /**
+     * Owner only, the most recently pushed task or nullptr.
+     */
+    function_wrapper *take() {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        ring *r = _ring.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = _top.load(std::memory_order_relaxed);
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        function_wrapper *task = r->get(b);
+        if (t == b) {
+            // last task, race the thieves for it
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    /**
+     * Any thread, the oldest task or nullptr if the deque is empty or another thread won the race for it.
+     */
+    function_wrapper *steal() {
+        int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        ring *r = _ring.load(std::memory_order_acquire);
+        function_wrapper *task = r->get(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+private:
+    class ring {
+    public:
+        explicit ring(int64_t size) : _size{size}, _tasks(new std::atomic<function_wrapper *>[size]) { }
+
+        inline int64_t size() const {
+            return _size;
+        }
+
+        inline function_wrapper *get(int64_t i) const {
+            return _tasks[i & (_size - 1)].load(std::memory_order_relaxed);
+        }
+
+        inline void put(int64_t i, function_wrapper *task) {
+            _tasks[i & (_size - 1)].store(task, std::memory_order_relaxed);
+        }
+
+    private:
+        int64_t _size;  // power of two
+        std::unique_ptr<std::atomic<function_wrapper *>[]> _tasks;
+    };
+
+    ring *grow(ring *r, int64_t t, int64_t b) {
+        _rings.emplace_back(new ring(r->size() * 2));
+        ring *bigger = _rings.back().get();
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, r->get(i));
+        }
+        _ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    std::atomic<int64_t> _top;
+    std::atomic<int64_t> _bottom;
+    std::atomic<ring *> _ring;
+    std::vector<std::unique_ptr<ring>> _rings;  // owner only
+};
+
+/**
+ * Thread pool with one work-stealing deque per worker. A task submitted from a worker, e.g. a BVH subtree,
+ * goes to the bottom of its own deque and is most likely run by it while the data is still in its cache,
+ * idle workers steal the oldest tasks of random victims. Tasks from other threads, e.g. the render
+ * partitions, go through one shared queue. Workers with nothing to run or steal sleep until a task arrives
+ * instead of spinning.
+ */
+class work_stealing_pool : public task_pool {
+public:
+    explicit work_stealing_pool(unsigned thread_count = std::thread::hardware_concurrency())
+            : _done{false}, _pending{0}, _sleeping{0}, _deques(thread_count) {
+        try {
+            for (unsigned i = 0; i < thread_count; ++i) {
+                _deques[i].reset(new work_stealing_deque);
+            }
+            for (unsigned i = 0; i < thread_count; ++i) {
+                _threads.push_back(std::thread(&work_stealing_pool::worker_thread, this, i));
+            }
+        } catch (...) {
+            shutdown();
+            throw;
+        }
+    }
+
+    ~work_stealing_pool() {
+        shutdown();
+        // tasks nobody ran are dropped, their futures report broken promises
+        for (function_wrapper *task : _injected) {
+            delete task;
+        }
+        for (std::unique_ptr<work_stealing_deque> &deque : _deques) {
+            while (function_wrapper *task = deque->steal()) {
+                delete task;
+            }
+        }
+    }
+
+    unsigned size() const override {
+        return static_cast<unsigned>(_threads.size());
+    }
+
+    void run_pending_task() override {
+        function_wrapper *task = find_task(worker_index());
+        if (task) {
+            run(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+protected:
+    void push(function_wrapper task) override {
+        function_wrapper *queued = new function_wrapper(std::move(task));
+        int index = worker_index();
+        if (index >= 0) {
+            _deques[index]->push(queued);
+        } else {
+            std::lock_guard<std::mutex> lk(_inject_mutex);
+            _injected.push_back(queued);
+        }
+        _pending.fetch_add(1);
+        // pairs with the check in park(), either the sleeper sees the task or it is woken here
+        if (_sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lk(_park_mutex);
+            _park_cond.notify_one();
+        }
+    }
+
+private:
+    /**
+     * Index of the calling thread among the workers of this pool, -1 for other threads.
+     */
+    int worker_index() const {
+        return current().pool == this ? current().index : -1;
+    }
+
+    struct worker_info {
+        const work_stealing_pool *pool;
+        int index;
+        uint32_t seed;
+    };
+
+    static worker_info &current() {
+        static thread_local worker_info info{nullptr, -1, 0};
+        return info;
+    }
+
+    void worker_thread(unsigned index) {
+        current() = worker_info{this, static_cast<int>(index), 2654435761u * (index + 1)};
+        while (!_done.load()) {
+            function_wrapper *task = find_task(static_cast<int>(index));
+            if (task) {
+                run(task);
+            } else {
+                park();
+            }
+        }
+    }
+
+    /**
+     * Own deque first, then the shared queue, then a few rounds of stealing from random victims.
+     */
+    function_wrapper *find_task(int index) {
+        if (index >= 0) {
+            if (function_wrapper *task = _deques[index]->take()) {
+                return task;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lk(_inject_mutex);
+            if (!_injected.empty()) {
+                function_wrapper *task = _injected.front();
+                _injected.pop_front();
+                return task;
+            }
+        }
+        const uint32_t n = static_cast<uint32_t>(_deques.size());
+        for (uint32_t round = 0; round < STEAL_ROUNDS * n; ++round) {
+            uint32_t victim = next_random() % n;
+            if (static_cast<int>(victim) == index) {
+                continue;
+            }
+            if (function_wrapper *task = _deques[victim]->steal()) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void run(function_wrapper *task) {
+        _pending.fetch_sub(1);
+        (*task)();
+        delete task;
+    }
+
+    /**
+     * Sleep until a task is queued or the pool shuts down.
+     */
+    void park() {
+        std::unique_lock<std::mutex> lk(_park_mutex);
+        _sleeping.fetch_add(1);
+        _park_cond.wait(lk, [this] { return _done.load() || _pending.load() > 0; });
+        _sleeping.fetch_sub(1);
+    }
+
+    static uint32_t next_random() {
+        // xorshift, a seed of 0 on non-worker threads is bumped to a non-zero state
+        uint32_t &x = current().seed;
+        x = x ? x : 0x9e3779b9u;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lk(_park_mutex);
+            _done = true;
+        }
+        _park_cond.notify_all();
+        for (std::thread &thread : _threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    std::atomic_bool _done;
+    std::atomic<int64_t> _pending;   // queued tasks not yet started
+    std::atomic<unsigned> _sleeping;
+    std::vector<std::unique_ptr<work_stealing_deque>> _deques;
+    std::mutex _inject_mutex;
+    std::deque<function_wrapper *> _injected;
+    std::mutex _park_mutex;
+    std::condition_variable _park_cond;
+    std::vector<std::thread> _threads;
+};
+
+}
+
+#endif //RAYTRACER_WORK_STEALING_POOL_H
@@ -63,11 +63,153 @@ std::ostream &operator<<(std::ostream &os, const Camera &camera) {
     return os;
 }
 
+/**
+ * Split prims[prim_at(0)] to prims[prim_at(count - 1)] into runs of primitives of the same surface and call
+ * visit(first, indices, n) for each, so a triangle mesh tests a run with its SIMD kernel.
+ * Spheres, triangles and instances are a single primitive each, they are visited one by one without gathering.
+ * Stops early and returns true once visit does.
+ */
+template<typename PrimAt, typename Visit>
+static bool for_each_run(const std::vector<Primitive> &prims, size_t count, PrimAt &&prim_at, Visit &&visit) {
+    uint32_t batch[BVH_MAX_LEAF_SIZE];
+    size_t k = 0;
+    while (k < count) {
+        const Primitive &first = prims[prim_at(k)];
+        if (first.type != PrimType::MESH && first.type != PrimType::SURFACE) {
+            ++k;
+            if (visit(first, &first.index, 1)) {
+                return true;
+            }
+            continue;
+        }
+        uint32_t n = 0;
+        for (; k < count && n < BVH_MAX_LEAF_SIZE && prims[prim_at(k)].surface == first.surface; ++k) {
+            batch[n++] = prims[prim_at(k)].index;
+        }
+        if (visit(first, batch, n)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Intersect runs of primitives. Spheres, triangles, triangle meshes and instances call their kernel for R
+ * directly instead of through the vtable, so no Render mode is checked per primitive.
+ */
+template<Render R, typename PrimAt>
+static void intersect_runs(Ray &ray, const std::vector<Primitive> &prims, size_t count, PrimAt &&prim_at) {
+    for_each_run(prims, count, prim_at, [&](const Primitive &first, const uint32_t *batch, uint32_t n) {
+        switch (first.type) {
+            case PrimType::SPHERE:
+                static_cast<const Sphere *>(first.surface)->intersect<R>(ray);
+                break;
+            case PrimType::TRIANGLE:
+                static_cast<const Triangle *>(first.surface)->intersect<R>(ray);
+                break;
+            case PrimType::MESH:
+                if (n == 1) {
+                    static_cast<const TriangleMesh *>(first.surface)->intersect<R>(ray, batch[0]);
+                } else {
+                    static_cast<const TriangleMesh *>(first.surface)->intersect_batch<R>(ray, batch, n);
+                }
+                break;
+            case PrimType::INSTANCE:
+                static_cast<const Instance *>(first.surface)->intersect<R>(ray);
+                break;
+            default:
+                if (n == 1) {
+                    first.surface->intersect(ray, R, batch[0]);
+                } else {
+                    first.surface->intersect_batch(ray, R, batch, n);
+                }
+                break;
+        }
+        return false;
+    });
+}
+
+template<Render R, typename PrimAt>
+static bool occluded_runs(const Ray &ray, float t_max, const std::vector<Primitive> &prims,
+                          size_t count, PrimAt &&prim_at) {
+    return for_each_run(prims, count, prim_at, [&](const Primitive &first, const uint32_t *batch, uint32_t n) {
+        switch (first.type) {
+            case PrimType::SPHERE:
+                return static_cast<const Sphere *>(first.surface)->occluded<R>(ray, t_max);
+            case PrimType::TRIANGLE:
+                return static_cast<const Triangle *>(first.surface)->occluded<R>(ray, t_max);
+            case PrimType::MESH:
+                return static_cast<const TriangleMesh *>(first.surface)->occluded_batch<R>(ray, batch, n, t_max);
+            case PrimType::INSTANCE:
+                return static_cast<const Instance *>(first.surface)->occluded<R>(ray, t_max);
+            default:
+                return n == 1 ? first.surface->occluded(ray, R, batch[0], t_max)
+                              : first.surface->occluded_batch(ray, R, batch, n, t_max);
+        }
+    });
+}
+
+/**
+ * Whether a Render mode tests all primitives instead of traversing the BVH, known at compile time.
+ */
+template<Render R>
+static constexpr bool brute_force() {
+    return R == Render::NORMAL || R == Render::BBOX_ONLY;
+}
+
+/**
+ * Intersect all primitives in the brute-force modes, or those in the leaves the ray visits.
+ */
+template<Render R>
+static void intersect_prims(Ray &ray, const std::vector<Primitive> &prims, const Accelerator &accel) {
+    if (brute_force<R>()) {
+        intersect_runs<R>(ray, prims, prims.size(), [](size_t k) {
+            return k;
+        });
+    } else {
+        accel.intersect_leaves(ray, [&](const uint32_t *leaf, uint32_t count) {
+            intersect_runs<R>(ray, prims, count, [leaf](size_t k) {
+                return leaf[k];
+            });
+        });
+    }
+}
+
+/**
+ * Whether any primitive blocks a shadow ray before t_max, the search ends with the first one found.
+ */
+template<Render R>
+static bool occluded_prims(const Ray &ray, float t_max, const std::vector<Primitive> &prims,
+                           const Accelerator &accel) {
+    if (brute_force<R>()) {
+        return occluded_runs<R>(ray, t_max, prims, prims.size(), [](size_t k) {
+            return k;
+        });
+    }
+    return accel.occluded(ray, t_max, [&](const uint32_t *leaf, uint32_t count) {
+        return occluded_runs<R>(ray, t_max, prims, count, [leaf](size_t k) {
+            return leaf[k];
+        });
+    });
+}
+
+/**
+ * Intersect all rays of a packet through the BVH, the leaves are tested ray by ray.
+ */
+template<Render R>
+static void intersect_packet(RayPacket &packet, const std::vector<Primitive> &prims, const Accelerator &accel) {
+    accel.intersect_packet(packet, [&](Ray &ray, const uint32_t *leaf, uint32_t count) {
+        intersect_runs<R>(ray, prims, count, [leaf](size_t k) {
+            return leaf[k];
+        });
+    });
+}
+
+template<Render R>
 std::pair<bool, Vector> Camera::blinn_phong(const Ray &pri_ray, const Point &light_pt, const Vector &light_cl,
                                             const Intersection &intersection,
-                                            const Material &material, const std::vector<Surface *> &objects,
-                                            const BVHNode *const parent,
-                                            const Render &flag) {
+                                            const Material &material, const std::vector<Primitive> &prims,
+                                            const Accelerator &accel) {
     std::pair<bool, Vector> ret(false, Vector());
 
     // create light ray from intersection point, shadow ray
@@ -75,21 +217,20 @@ std::pair<bool, Vector> Camera::blinn_phong(const Ray &pri_ray, const Point &lig
     float interMagnitude = lightRayDir.magnitude();
     lightRayDir /= interMagnitude;
     Ray shadowRay{intersection.point(), lightRayDir};
+    shadowRay.start_at(intersection);
+    shadowRay.stats(pri_ray.stats());
 
-    int obj_size = static_cast<int>(objects.size());
+    RenderStats *stats = shadowRay.stats();
+    uint64_t visited = stats ? stats->node_visits : 0;
 
-    // render flag
-    if (flag == Render::NORMAL || flag == Render::BBOX_ONLY) {
-        for (int j = 0; j < obj_size; ++j) {
-            if (objects[j] != intersection.id()) {
-                objects[j]->intersect(shadowRay, flag);
-            }
-        }
-    } else {
-        BVHNode::intersect(shadowRay, parent, intersection.id(), flag);
+    // render flag, the primitive the shadow ray starts on skips itself, any hit before the light blocks it
+    bool blocked = occluded_prims<R>(shadowRay, interMagnitude, prims, accel);
+    if (stats) {
+        stats->shadow_rays++;
+        stats->shadow_nodes += stats->node_visits - visited;
     }
 
-    if (!shadowRay.has_block(interMagnitude)) {
+    if (!blocked) {
         ret.first = true;
         // diffuse
         float d_scalar = intersection.normal().dot(lightRayDir);
@@ -106,32 +247,30 @@ std::pair<bool, Vector> Camera::blinn_phong(const Ray &pri_ray, const Point &lig
     return std::move(ret);
 }
 
+template<Render R>
 Vector Camera::L(Ray &ray, int recursive_limit, const Surface *const object_id,
-                 const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                 const BVHNode *const parent, const Render &flag, int s_sampling_num,
-                 const std::function<float()> &rand_float) {
-    static float inv_s_sampling_num_pow2 = 1.0f / (s_sampling_num * s_sampling_num);
+                 const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                 const Accelerator &accel, int s_sampling_num, const std::function<float()> &rand_float) {
     if (recursive_limit == 0)
         return std::move(Vector{0.0f, 0.0f, 0.0f});
 
-    // compute ray intersection with all objects
-    int obj_size = static_cast<int>(objects.size());
-    if (flag == Render::NORMAL || flag == Render::BBOX_ONLY) {
-        // I have to write like this, more redundant code to avoid useless checks in for loop
-        if (object_id) {
-            for (int i = 0; i < obj_size; ++i) {
-                if (objects[i] != object_id) {
-                    objects[i]->intersect(ray, flag);
-                }
-            }
-        } else {
-            for (int i = 0; i < obj_size; ++i) {
-                objects[i]->intersect(ray, flag);
-            }
-        }
-    } else {
-        BVHNode::intersect(ray, parent, object_id, flag);
+    // compute ray intersection with all primitives, a reflection ray skips the one it starts on by itself
+    RenderStats *stats = ray.stats();
+    uint64_t visited = stats ? stats->node_visits : 0;
+    intersect_prims<R>(ray, prims, accel);
+    if (stats) {
+        // rays leaving a surface are reflections, the others come from the camera
+        (object_id ? stats->reflection_rays : stats->primary_rays)++;
+        (object_id ? stats->reflection_nodes : stats->primary_nodes) += stats->node_visits - visited;
     }
+    return shade<R>(ray, recursive_limit, prims, lights, accel, s_sampling_num, rand_float);
+}
+
+template<Render R>
+Vector Camera::shade(const Ray &ray, int recursive_limit,
+                     const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                     const Accelerator &accel, int s_sampling_num, const std::function<float()> &rand_float) {
+    static float inv_s_sampling_num_pow2 = 1.0f / (s_sampling_num * s_sampling_num);
 
     // no intersection, return empty vector
     if (!ray.has_intersect()) {
@@ -139,24 +278,25 @@ Vector Camera::L(Ray &ray, int recursive_limit, const Surface *const object_id,
     }
     // hold return value
     Vector rgb;
-    // get intersection, object, material
-    const Intersection &intersection = ray.intersection();
-    const Surface &surface = *intersection.id();
-    const Material &material = surface.material();
-    // iterate over all lights, use iterator
-    for (auto &light_ptr : lights) {
-        if (PointLight *pointLight = dynamic_cast<PointLight *>(light_ptr)) {  // For point light
+    // point and normal of the closest hit, material
+    const Intersection intersection = ray.hit().id->intersection(ray, R);
+    const Material &material = intersection.material();
+    // iterate over all lights, their types were looked up once per render
+    for (const LightRef &light_ref : lights) {
+        if (light_ref.kind == LightRef::Kind::POINT) {  // For point light
+            PointLight *pointLight = static_cast<PointLight *>(light_ref.light);
             // compute shading
-            rgb += blinn_phong(ray, pointLight->orig(), pointLight->color(), intersection, material, objects, parent,
-                               flag).second;
-        } else if (AmbientLight *ambientLight = dynamic_cast<AmbientLight *>(light_ptr)) {  // for ambient light
-            rgb += material.kd() * ambientLight->color();
-        } else if (AreaLight *areaLight = dynamic_cast<AreaLight *>(light_ptr)) {    // for square area light
+            rgb += blinn_phong<R>(ray, pointLight->orig(), pointLight->color(), intersection, material, prims,
+                                  accel).second;
+        } else if (light_ref.kind == LightRef::Kind::AMBIENT) {  // for ambient light
+            rgb += material.kd() * static_cast<AmbientLight *>(light_ref.light)->color();
+        } else {    // for square area light
+            AreaLight *areaLight = static_cast<AreaLight *>(light_ref.light);
             Vector sub_rgb;
             if (s_sampling_num == 1) {
                 // compute shading
-                std::pair<bool, Vector> temp = blinn_phong(ray, areaLight->orig(), areaLight->color(), intersection,
-                                                           material, objects, parent, flag);
+                std::pair<bool, Vector> temp = blinn_phong<R>(ray, areaLight->orig(), areaLight->color(),
+                                                              intersection, material, prims, accel);
                 if (temp.first) {
                     // create light vector from intersection point
                     Vector lightRayDir = areaLight->orig() - intersection.point();
@@ -169,8 +309,8 @@ Vector Camera::L(Ray &ray, int recursive_limit, const Surface *const object_id,
                 }
             } else {
                 for (Point &sample_p : areaLight->sample(s_sampling_num, rand_float)) {
-                    std::pair<bool, Vector> temp = blinn_phong(ray, sample_p, areaLight->color(), intersection,
-                                                               material, objects, parent, flag);
+                    std::pair<bool, Vector> temp = blinn_phong<R>(ray, sample_p, areaLight->color(), intersection,
+                                                                  material, prims, accel);
                     if (temp.first) {
                         // create light vector from intersection point
                         Vector lightRayDir = sample_p - intersection.point();
@@ -195,76 +335,370 @@ Vector Camera::L(Ray &ray, int recursive_limit, const Surface *const object_id,
         refRayDir += ray.dir();
         refRayDir.normalize();
         Ray refRay{intersection.point(), refRayDir};
+        refRay.start_at(intersection);
+        refRay.stats(ray.stats());
         // recursively compute it
         rgb += material.ki() *
-               L(refRay, recursive_limit - 1, intersection.id(), objects, lights, parent, flag, s_sampling_num, rand_float);
+               L<R>(refRay, recursive_limit - 1, intersection.id(), prims, lights, accel, s_sampling_num, rand_float);
         return std::move(rgb);
     } else {
         return std::move(rgb);
     }
 }
 
-void Camera::render(const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                    const BVHNode *const parent, const SceneConfig &sceneConfig) {
-    const size_t partition_num {sceneConfig.partition_num()};
-    const size_t partition_size {(_nx * _ny + partition_num - 1) / partition_num};
-    thread_pool pool(sceneConfig.thread_num());
+/**
+ * Every other bit of a Morton code, from bit 0 on, packed together: x of the code, y is morton_part(code >> 1).
+ */
+static inline uint32_t morton_part(uint32_t code) {
+    code &= 0x55555555u;
+    code = (code | (code >> 1)) & 0x33333333u;
+    code = (code | (code >> 2)) & 0x0f0f0f0fu;
+    code = (code | (code >> 4)) & 0x00ff00ffu;
+    code = (code | (code >> 8)) & 0x0000ffffu;
+    return code;
+}
+
+/**
+ * The cells of a w x h grid in Z order. Codes falling outside the grid are skipped, so the order
+ * stays local for grids that are not square powers of two.
+ */
+static std::vector<std::pair<int, int>> z_order(int w, int h) {
+    std::vector<std::pair<int, int>> cells;
+    cells.reserve(static_cast<size_t>(w) * h);
+    uint32_t code {0};
+    while (cells.size() < cells.capacity()) {
+        int x {static_cast<int>(morton_part(code))};
+        int y {static_cast<int>(morton_part(code >> 1))};
+        if (x < w && y < h) {
+            cells.emplace_back(x, y);
+        }
+        ++code;
+    }
+    return cells;
+}
+
+/**
+ * A uniform [0, 1) generator seeded from the clock, one per partition or worker.
+ */
+static std::function<float()> make_rand_float() {
+    long seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::default_random_engine generator(seed);
+    std::uniform_real_distribution<float> distribution(0.0, 1.0);
+    return bind(distribution, generator);
+}
+
+void Camera::schedule(const SceneConfig &sceneConfig) {
+    const int bx {static_cast<int>(blocks_x())};
+    const int by {static_cast<int>(blocks_y())};
+    _blocks.clear();
+    _blocks.reserve(static_cast<size_t>(bx) * by);
+    _tile_first.assign(1, 0);
+    _morton_pixels = sceneConfig.tile_order() == TileOrder::MORTON;
+
+    if (sceneConfig.tile_order() == TileOrder::LINEAR) {
+        // every block is a tile of its own, row by row
+        for (int y {0}; y < by; ++y) {
+            for (int x {0}; x < bx; ++x) {
+                _blocks.push_back(Block{x * PACKET_WIDTH, y * PACKET_WIDTH});
+                _tile_first.push_back(_blocks.size());
+            }
+        }
+        return;
+    }
+
+    // tiles in Z order, the blocks of each in Z order again, border tiles are cut at the image edge
+    const int tw {static_cast<int>((sceneConfig.tile_width() + PACKET_WIDTH - 1) / PACKET_WIDTH)};
+    const int th {static_cast<int>((sceneConfig.tile_height() + PACKET_WIDTH - 1) / PACKET_WIDTH)};
+    const std::vector<std::pair<int, int>> inner = z_order(tw, th);
+    for (const std::pair<int, int> &tile : z_order((bx + tw - 1) / tw, (by + th - 1) / th)) {
+        for (const std::pair<int, int> &block : inner) {
+            int x {tile.first * tw + block.first};
+            int y {tile.second * th + block.second};
+            if (x < bx && y < by) {
+                _blocks.push_back(Block{x * PACKET_WIDTH, y * PACKET_WIDTH});
+            }
+        }
+        _tile_first.push_back(_blocks.size());
+    }
+}
+
+void Camera::tasks(size_t task_num, bool adaptive) {
+    _task_first.assign(1, 0);
+    const bool predicted = adaptive && _cost_map.width() == static_cast<int>(blocks_x()) &&
+                           _cost_map.height() == static_cast<int>(blocks_y()) && _cost_map.total() > 0;
+    if (predicted) {
+        // cut the schedule where the block times of the last render reach the next equal share, so cheap
+        // tiles are merged into one task and expensive ones are spread over several
+        const double total {_cost_map.total()};
+        double cost {0};
+        for (size_t i {0}; i < _blocks.size(); ++i) {
+            cost += _cost_map.block(_blocks[i].x0 / PACKET_WIDTH, _blocks[i].y0 / PACKET_WIDTH);
+            while (_task_first.size() < task_num && cost >= total * _task_first.size() / task_num) {
+                _task_first.push_back(i + 1);
+            }
+        }
+    } else if (task_num > 0) {
+        // runs of the same number of tiles, an empty image, e.g. from a scene file without a camera line,
+        // has no tiles and gets no task from the tile counter
+        const size_t task_size {(tile_num() + task_num - 1) / task_num};
+        for (size_t i {1}; i < task_num; ++i) {
+            _task_first.push_back(_tile_first[std::min(i * task_size, tile_num())]);
+        }
+    }
+    _task_first.resize(task_num + 1, _blocks.size());
+
+    _cost_map.reset(static_cast<int>(blocks_x()), static_cast<int>(blocks_y()));
+    _cost_map.tasks().assign(task_num, .0f);
+}
+
+void Camera::render(const std::vector<Primitive> &prims, const std::vector<Light *> &lights,
+                    const Accelerator &accel, const SceneConfig &sceneConfig, task_pool &pool) {
+    // the partitions or workers take the tiles in schedule order
+    schedule(sceneConfig);
+
+    // look up the light types once instead of for every hit, lights of other types are not shaded
+    std::vector<LightRef> light_refs;
+    for (Light *light : lights) {
+        if (dynamic_cast<PointLight *>(light)) {
+            light_refs.push_back(LightRef{LightRef::Kind::POINT, light});
+        } else if (dynamic_cast<AmbientLight *>(light)) {
+            light_refs.push_back(LightRef{LightRef::Kind::AMBIENT, light});
+        } else if (dynamic_cast<AreaLight *>(light)) {
+            light_refs.push_back(LightRef{LightRef::Kind::AREA, light});
+        }
+    }
 
-    // render each partition in parallel
+    // the render mode is dispatched here once, every partition or worker runs the instance for it
+    using Partition = void (Camera::*)(const size_t, const std::vector<Primitive> &,
+                                       const std::vector<LightRef> &, const Accelerator &, const SceneConfig &,
+                                       RenderStats &);
+    using Worker = void (Camera::*)(std::atomic<size_t> &, const std::vector<Primitive> &,
+                                    const std::vector<LightRef> &, const Accelerator &, const SceneConfig &,
+                                    RenderStats &);
+    Partition partition;
+    Worker worker;
+    switch (sceneConfig.render_flag()) {
+        case Render::NORMAL:
+            partition = &Camera::render_partition<Render::NORMAL>;
+            worker = &Camera::render_worker<Render::NORMAL>;
+            break;
+        case Render::BBOX_ONLY:
+            partition = &Camera::render_partition<Render::BBOX_ONLY>;
+            worker = &Camera::render_worker<Render::BBOX_ONLY>;
+            break;
+        case Render::BVH_BBOX_ONLY:
+            partition = &Camera::render_partition<Render::BVH_BBOX_ONLY>;
+            worker = &Camera::render_worker<Render::BVH_BBOX_ONLY>;
+            break;
+        default: /* Render::BVH */
+            partition = &Camera::render_partition<Render::BVH>;
+            worker = &Camera::render_worker<Render::BVH>;
+            break;
+    }
+
+    std::vector<RenderStats> stats;
+    if (sceneConfig.parallel_method() == ParallelMethod::TILE_COUNTER) {
+        // a fixed set of workers pulls tasks off one counter until none are left, the calling thread is one
+        // of them, so there is one pool task per thread and a single wait at the end. The counter balances
+        // the tiles already, so they are handed out one by one and not cut by the cost map.
+        tasks(tile_num(), false);
+        if (task_num() == 0) {
+            merge_stats(stats);
+            return;
+        }
+        const size_t worker_num {std::max<size_t>(1, std::min<size_t>(pool.size(), task_num()))};
+        std::atomic<size_t> next_task{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto run = [&](size_t i) {
+            try {
+                (this->*worker)(next_task, prims, light_refs, accel, sceneConfig, stats[i]);
+            } catch (...) {
+                // the other workers stop at their next task, the first error is rethrown once all are done
+                next_task = task_num();
+                std::lock_guard<std::mutex> lk(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        };
+        countdown_latch finished(worker_num - 1);
+        stats.resize(worker_num);
+        for (size_t i {1}; i < worker_num; ++i) {
+            pool.submit([&, i]() {
+                run(i);
+                finished.count_down();
+            });
+        }
+        run(0);
+        finished.wait();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        merge_stats(stats);
+        return;
+    }
+
+    // render each partition in parallel, each one counting into its own stats
+    const size_t partition_num {sceneConfig.partition_num()};
+    tasks(partition_num, sceneConfig.adaptive_partitions());
     std::vector<std::future<void>> futures(partition_num);
+    stats.resize(partition_num);
     for (size_t i {0}; i < partition_num; ++i) {
         if (sceneConfig.parallel_method() == ParallelMethod::STD_ASYNC) {
-            futures[i] = async(&Camera::render_partition, this, i, partition_size,
-                               std::cref(objects), std::cref(lights), std::cref(parent), std::cref(sceneConfig));
+            futures[i] = async(partition, this, i,
+                               std::cref(prims), std::cref(light_refs), std::cref(accel), std::cref(sceneConfig),
+                               std::ref(stats[i]));
         } else if (sceneConfig.parallel_method() == ParallelMethod::STD_ASYNC_FORCE) {
-            futures[i] = async(std::launch::async, &Camera::render_partition, this, i, partition_size,
-                               std::cref(objects), std::cref(lights), std::cref(parent), std::cref(sceneConfig));
-        } else { /* ParallelMethod::THREAD_POOL */
-            futures[i] = pool.submit(bind(&Camera::render_partition, this, i, partition_size,
-                                          std::cref(objects), std::cref(lights), std::cref(parent), std::cref(sceneConfig)));
+            futures[i] = async(std::launch::async, partition, this, i,
+                               std::cref(prims), std::cref(light_refs), std::cref(accel), std::cref(sceneConfig),
+                               std::ref(stats[i]));
+        } else { /* ParallelMethod::THREAD_POOL, ParallelMethod::WORK_STEALING */
+            futures[i] = pool.submit(bind(partition, this, i,
+                                          std::cref(prims), std::cref(light_refs), std::cref(accel),
+                                          std::cref(sceneConfig), std::ref(stats[i])));
         }
     }
     for (auto &f : futures) {
         f.get();
     }
+    merge_stats(stats);
 }
 
-void Camera::render_partition(const size_t partition_id, const size_t partition_size,
-                              const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                              const BVHNode *const parent, const SceneConfig &sceneConfig) {
-    const int sampling_num_pow2 = std::pow(sceneConfig.pixel_sampling_num(), 2);
-    long seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::default_random_engine generator(seed);
-    std::uniform_real_distribution<float> distribution(0.0, 1.0);
-    std::function<float()> rand_float = bind(distribution, generator);
-
-    size_t pixel_start = partition_id * partition_size;
-    size_t pixel_end = std::min(pixel_start + partition_size, static_cast<size_t>(_nx) * _ny);
-    for (size_t i {pixel_start}; i < pixel_end; ++i) {
-        int x {static_cast<int>(i % _nx)};
-        int y {static_cast<int>(i / _nx)};
-        Vector rgb = render_pixel(x, y, objects, lights, parent, sceneConfig, rand_float);
-        rgb /= sampling_num_pow2;
-        _image.pixel(x, y, rgb);
+void Camera::merge_stats(const std::vector<RenderStats> &stats) {
+    _stats = RenderStats{};
+    for (const RenderStats &partition : stats) {
+        _stats.merge(partition);
+    }
+}
+
+template<Render R>
+void Camera::render_partition(const size_t partition_id,
+                              const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                              const Accelerator &accel, const SceneConfig &sceneConfig, RenderStats &stats) {
+    std::function<float()> rand_float = make_rand_float();
+
+    render_task<R>(partition_id, prims, lights, accel, sceneConfig, rand_float, stats);
+}
+
+template<Render R>
+void Camera::render_worker(std::atomic<size_t> &next_task,
+                           const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                           const Accelerator &accel, const SceneConfig &sceneConfig, RenderStats &stats) {
+    std::function<float()> rand_float = make_rand_float();
+
+    for (size_t task; (task = next_task.fetch_add(1, std::memory_order_relaxed)) < task_num();) {
+        render_task<R>(task, prims, lights, accel, sceneConfig, rand_float, stats);
+    }
+}
+
+template<Render R>
+void Camera::render_task(size_t task,
+                         const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                         const Accelerator &accel, const SceneConfig &sceneConfig,
+                         const std::function<float()> &rand_float, RenderStats &stats) {
+    const int sampling_num_pow2 = sceneConfig.pixel_sampling_num() * sceneConfig.pixel_sampling_num();
+
+    // primary rays of a block are coherent enough to share a BVH traversal, the other modes have no tree
+    const bool packets = sceneConfig.packet_tracing() && !brute_force<R>();
+
+    // every block is timed for the cost map, only this task writes its blocks
+    float task_ms {0};
+    for (size_t i {_task_first[task]}; i < _task_first[task + 1]; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        int x0 {_blocks[i].x0};
+        int y0 {_blocks[i].y0};
+        int x1 {std::min(x0 + PACKET_WIDTH, _nx)};
+        int y1 {std::min(y0 + PACKET_WIDTH, _ny)};
+        if (packets) {
+            render_block<R>(x0, y0, x1, y1, prims, lights, accel, sceneConfig, rand_float, stats);
+        } else {
+            for (int k {0}; k < PACKET_SIZE; ++k) {
+                int x {x0 + static_cast<int>(_morton_pixels ? morton_part(k) : k % PACKET_WIDTH)};
+                int y {y0 + static_cast<int>(_morton_pixels ? morton_part(k >> 1) : k / PACKET_WIDTH)};
+                if (x >= x1 || y >= y1) {
+                    continue;
+                }
+                Vector rgb = render_pixel<R>(x, y, prims, lights, accel, sceneConfig, rand_float, stats);
+                rgb /= sampling_num_pow2;
+                _image.pixel(x, y, rgb);
+            }
+        }
+        std::chrono::duration<float, std::milli> ms = std::chrono::steady_clock::now() - start;
+        _cost_map.block(x0 / PACKET_WIDTH, y0 / PACKET_WIDTH, ms.count());
+        task_ms += ms.count();
+    }
+    _cost_map.tasks()[task] = task_ms;
+}
+
+template<Render R>
+void Camera::render_block(int x0, int y0, int x1, int y1,
+                         const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                         const Accelerator &accel, const SceneConfig &sceneConfig,
+                         const std::function<float()> &rand_float, RenderStats &stats) {
+    const int sampling_num = sceneConfig.pixel_sampling_num();
+    Vector rgb[PACKET_SIZE];
+
+    // one packet per sample position, its lanes are the pixels of the block in row-major order
+    for (int p = 0; p < sampling_num && sceneConfig.recursive_limit() > 0; p++) {
+        for (int q = 0; q < sampling_num; q++) {
+            RayPacket packet;
+            for (int y {y0}; y < y1; ++y) {
+                for (int x {x0}; x < x1; ++x) {
+                    if (sampling_num == 1) {
+                        packet.add(project_pixel(x, y));
+                    } else {
+                        packet.add(project_pixel(x + (p + rand_float()) / sampling_num,
+                                                 y + (q + rand_float()) / sampling_num));
+                    }
+                }
+            }
+            for (unsigned lane = 0; lane < packet.size(); ++lane) {
+                packet.ray(lane).stats(&stats);
+            }
+            packet.finish();
+
+            uint64_t visited = stats.node_visits;
+            intersect_packet<R>(packet, prims, accel);
+            stats.primary_packets++;
+            stats.primary_rays += packet.size();
+            stats.primary_nodes += stats.node_visits - visited;
+
+            for (unsigned lane = 0; lane < packet.size(); ++lane) {
+                rgb[lane] += shade<R>(packet.ray(lane), sceneConfig.recursive_limit(), prims, lights, accel,
+                                      sceneConfig.shadow_sampling_num(), rand_float);
+            }
+        }
+    }
+
+    unsigned lane = 0;
+    for (int y {y0}; y < y1; ++y) {
+        for (int x {x0}; x < x1; ++x) {
+            rgb[lane] /= sampling_num * sampling_num;
+            _image.pixel(x, y, rgb[lane++]);
+        }
     }
 }
 
-Vector Camera::render_pixel(int x, int y, const std::vector<Surface *> &objects, const std::vector<Light *> &lights,
-                            const BVHNode *const parent, const SceneConfig &sceneConfig,
-                            const std::function<float()> &rand_float) {
+template<Render R>
+Vector Camera::render_pixel(int x, int y, const std::vector<Primitive> &prims, const std::vector<LightRef> &lights,
+                            const Accelerator &accel, const SceneConfig &sceneConfig,
+                            const std::function<float()> &rand_float, RenderStats &stats) {
     Vector rgb;
 
     if (sceneConfig.pixel_sampling_num() == 1) {
         Ray ray = project_pixel(x, y);
-        rgb += L(ray, sceneConfig.recursive_limit(), nullptr, objects, lights, parent, sceneConfig.render_flag(),
-                 sceneConfig.shadow_sampling_num(), rand_float);
+        ray.stats(&stats);
+        rgb += L<R>(ray, sceneConfig.recursive_limit(), nullptr, prims, lights, accel,
+                    sceneConfig.shadow_sampling_num(), rand_float);
     } else {
         for (int p = 0; p < sceneConfig.pixel_sampling_num(); p++) {
             for (int q = 0; q < sceneConfig.pixel_sampling_num(); q++) {
                 Ray sampling_ray = project_pixel(x + (p + rand_float()) / sceneConfig.pixel_sampling_num(),
                                                  y + (q + rand_float()) / sceneConfig.pixel_sampling_num());
-                rgb += L(sampling_ray, sceneConfig.recursive_limit(), nullptr, objects, lights, parent,
-                         sceneConfig.render_flag(), sceneConfig.shadow_sampling_num(), rand_float);
+                sampling_ray.stats(&stats);
+                rgb += L<R>(sampling_ray, sceneConfig.recursive_limit(), nullptr, prims, lights, accel,
+                            sceneConfig.shadow_sampling_num(), rand_float);
             }
         }
     }
@@ -7,7 +7,11 @@
 
 namespace mmgl {
 
-Scene::Scene(const std::string &scene_file) {
+Scene::Scene(const std::string &scene_file) : _materials{}, _surfaces{}, _positions{}, _removed_num{0}, _spheres{},
+                                              _triangles{}, _meshes{},
+                                              _lights{}, _camera{}, _config{}, _prims{}, _bounded_num{0}, _prims_dirty{true}, _accel{}, _accel_dirty{true}, _first_prim{},
+                                              _changed{}, _bvh_stats{}, _pool{}, _pool_shared{false}, _pool_threads{0},
+                                              _pool_method{ParallelMethod::THREAD_POOL} {
     std::ifstream inFile(scene_file);    // open the file
     std::string line;
 
@@ -21,9 +25,6 @@ Scene::Scene(const std::string &scene_file) {
     float dr, dg, db, sr, sg, sb, ir, ig, ib;
     float d, iw, ih;
     int pw, ph;
-    unsigned long n;
-    std::vector<int> tris;
-    std::vector<float> verts;
 
     while (!inFile.eof()) {   // go through every line in the file until finished
 
@@ -161,25 +162,35 @@ Scene::Scene(const std::string &scene_file) {
 
                 break;
 
-            case 'w':
-                parse_obj_file(line.substr(line.find(' ') + 1), tris, verts);
-
-                n = tris.size() / 3;
-                for (unsigned long i = 0; i < n; ++i) {
-                    x = verts[3 * tris[3 * i]];
-                    y = verts[3 * tris[3 * i] + 1];
-                    z = verts[3 * tris[3 * i] + 2];
-                    x2 = verts[3 * tris[3 * i + 1]];
-                    y2 = verts[3 * tris[3 * i + 1] + 1];
-                    z2 = verts[3 * tris[3 * i + 1] + 2];
-                    x3 = verts[3 * tris[3 * i + 2]];
-                    y3 = verts[3 * tris[3 * i + 2] + 1];
-                    z3 = verts[3 * tris[3 * i + 2] + 2];
-                    triangle(x, y, z, x2, y2, z2, x3, y3, z3, lastMaterialLoaded);
-                }
+            case 'p':   // plane: normal and distance to the origin
+                x = get_token_as_float(line, 1);
+                y = get_token_as_float(line, 2);
+                z = get_token_as_float(line, 3);
+                d = get_token_as_float(line, 4);
+
+                plane(x, y, z, d, lastMaterialLoaded);
+
+                break;
+
+            case 'w':   // obj file, loaded as one triangle mesh
+                triangle_mesh(line.substr(line.find(' ') + 1), lastMaterialLoaded);
 
                 break;
 
+            case 'i': {  // instance of an obj mesh: file, translation, rotation around y in degrees, uniform scale
+                std::string obj_file = line.substr(2, line.find(' ', 2) - 2);
+                x = get_token_as_float(line, 2);
+                y = get_token_as_float(line, 3);
+                z = get_token_as_float(line, 4);
+                d = get_token_as_float(line, 5);
+                r = get_token_as_float(line, 6);
+
+                instance(mesh(obj_file), Transform{}.scale(r, r, r).rotate(d, 0, 1, 0).translate(x, y, z),
+                         lastMaterialLoaded);
+
+                break;
+            }
+
             case '/':
                 // don't do anything, it's a comment
                 break;
@@ -198,74 +209,205 @@ Scene::Scene(const std::string &scene_file) {
     }
 }
 
+std::shared_ptr<task_pool> Scene::pool() {
+    if (_pool_shared) {
+        return _pool;
+    }
+    // the work-stealing method needs its own kind of pool, the others all run on the plain one
+    ParallelMethod method = _config.parallel_method() == ParallelMethod::WORK_STEALING ?
+                            ParallelMethod::WORK_STEALING : ParallelMethod::THREAD_POOL;
+    if (!_pool || _pool_threads != _config.thread_num() || _pool_method != method) {
+        _pool.reset();
+        if (method == ParallelMethod::WORK_STEALING) {
+            _pool = std::make_shared<work_stealing_pool>(_config.thread_num());
+        } else {
+            _pool = std::make_shared<thread_pool>(_config.thread_num());
+        }
+        _pool_threads = _config.thread_num();
+        _pool_method = method;
+    }
+    return _pool;
+}
+
+Scene &Scene::pool(std::shared_ptr<task_pool> pool) {
+    _pool = std::move(pool);
+    _pool_shared = static_cast<bool>(_pool);
+    return *this;
+}
+
 void Scene::render() {
+    if (_removed_num > 0) {
+        // removing a surface only leaves a hole, they are all closed up here in one pass
+        size_t n = 0;
+        for (Surface *surface : _surfaces) {
+            if (surface) {
+                _positions[surface] = n;
+                _surfaces[n++] = surface;
+            }
+        }
+        _surfaces.resize(n);
+        _removed_num = 0;
+    }
     if (_surfaces.empty()) {
         throw RenderException("Please at least have one surface to render, or do you really want a fully-dark image?");
     }
 
-    std::vector<Surface *> objects_vec;
-    std::vector<Light *> lights_vec;
-
-    std::copy(_surfaces.begin(), _surfaces.end(), std::back_inserter(objects_vec));
-    std::copy(_lights.begin(), _lights.end(), std::back_inserter(lights_vec));
+    using namespace std::chrono;
+    // the pool also runs the BVH build tasks, held here in case it is replaced while rendering
+    std::shared_ptr<task_pool> pool = this->pool();
+
+    if (_prims_dirty) {
+        // every surface contributes its primitives, a triangle mesh one per triangle
+        _prims.clear();
+        _first_prim.clear();
+        for (const Surface *surface : _surfaces) {
+            if (!surface->bounded()) {
+                continue;
+            }
+            _first_prim[surface] = static_cast<uint32_t>(_prims.size());
+            for (uint32_t i = 0; i < surface->prim_num(); ++i) {
+                _prims.push_back(Primitive{surface, i, surface->prim_type()});
+            }
+        }
+        // unbounded primitives go last, the BVH is built over the ones before and visits these separately
+        _bounded_num = static_cast<uint32_t>(_prims.size());
+        std::vector<uint32_t> unbounded;
+        for (const Surface *surface : _surfaces) {
+            for (uint32_t i = 0; !surface->bounded() && i < surface->prim_num(); ++i) {
+                unbounded.push_back(static_cast<uint32_t>(_prims.size()));
+                _prims.push_back(Primitive{surface, i, surface->prim_type()});
+            }
+        }
+        _accel.unbounded(std::move(unbounded));
+        _prims_dirty = false;
+        _accel_dirty = true;
+    }
 
-    // build bvh tree
-    BVHNode *parent = nullptr;
-    if (_config.render_flag() == Render::BVH || _config.render_flag() == Render::BVH_BBOX_ONLY) {
-        // in case of we only have one object
-        if (!(parent = dynamic_cast<BVHNode *>(
-                BVHNode::create_bvh_tree(objects_vec.begin(), objects_vec.end(), _config.bvh_mode())))) {
-            parent = new BVHNode(objects_vec.begin(), objects_vec.end());
-            parent->_left = objects_vec[0];
+    // (re)build bvh over the primitive boxes only if it is stale, leaves refer back to _prims by index
+    bool use_bvh = _config.render_flag() == Render::BVH || _config.render_flag() == Render::BVH_BBOX_ONLY;
+    bool rebuild = use_bvh && (_accel_dirty || _accel.empty() || _accel.bvh_mode() != _config.bvh_mode() ||
+                               _accel.width() != _config.bvh_width() || _accel.leaf_size() != _config.leaf_size());
+    auto build_start = high_resolution_clock::now();
+    bool refit = use_bvh && !rebuild && !_changed.empty();
+    if (refit) {
+        // moved surfaces keep the topology, refit it unless the tree degraded too much
+        rebuild = !_accel.refit([this](uint32_t i) { return _prims[i].surface->prim_box(_prims[i].index); },
+                                _changed, _config.refit_threshold(), pool.get());
+        _changed.clear();
+    }
+    if (rebuild) {
+        std::vector<BBox> boxes;
+        boxes.reserve(_bounded_num);
+        for (uint32_t i = 0; i < _bounded_num; ++i) {
+            boxes.push_back(_prims[i].surface->prim_box(_prims[i].index));
         }
+        _accel.build(boxes, _config.bvh_mode(), _config.bvh_width(), _config.leaf_size(), pool.get(),
+                     [this](uint32_t i, const BBox &bounds) {
+                         return _prims[i].surface->prim_clip(_prims[i].index, bounds);
+                     });
+        _accel_dirty = false;
+        _changed.clear();
+    }
+    auto build_end = high_resolution_clock::now();
+    if (rebuild || refit) {
+        _bvh_stats = _accel.stats();
     }
 
     // render
-    using namespace std::chrono;
     auto func_start = high_resolution_clock::now();
-    _camera.render(objects_vec, lights_vec, parent, _config);
+    _camera.render(_prims, _lights, _accel, _config, *pool);
     auto func_end = high_resolution_clock::now();
 
     if (_config.logging()) {
+        if (rebuild) {
+            std::cout << "Finish building BVH in " << duration_cast<milliseconds>(build_end - build_start).count() << " ms" << std::endl;
+        } else if (refit) {
+            std::cout << "Finish refitting BVH in " << duration_cast<milliseconds>(build_end - build_start).count() << " ms" << std::endl;
+        }
         std::cout << "Finish rendering in " << duration_cast<milliseconds>(func_end - func_start).count() << " ms" << std::endl;
+        if (use_bvh) {
+            std::cout << _bvh_stats << std::endl;
+        }
+        std::cout << render_stats() << std::endl;
+        std::cout << cost_map() << std::endl;
     }
+}
+
+Sphere &Scene::sphere(float x, float y, float z, float radius, const Material &material) {
+    return add(_spheres.add(x, y, z, radius), material);
+}
 
-    // clean up memory, using BFS
-    if (parent) {
-        std::queue<BVHNode *> q;
-        q.push(parent);
-        while (!q.empty()) {
-            BVHNode *node = q.front();
-            q.pop();
+Plane &Scene::plane(float nx, float ny, float nz, float d, const Material &material) {
+    return add(*new Plane(nx, ny, nz, d), material);
+}
 
-            BVHNode *node_left = nullptr;
-            BVHNode *node_right = nullptr;
+Triangle &Scene::triangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3,
+                          float z3, const Material &material) {
+    return add(_triangles.add(x1, y1, z1, x2, y2, z2, x3, y3, z3), material);
+}
 
-            if (node->_left && (node_left = dynamic_cast<BVHNode *>(node->_left))) {
-                q.push(node_left);
-            }
-            if (node->_right && (node_right = dynamic_cast<BVHNode *>(node->_right))) {
-                q.push(node_right);
-            }
+TriangleMesh &Scene::triangle_mesh(const std::string &obj_file, const Material &material) {
+    std::vector<uint32_t> indices;
+    std::vector<float> xs, ys, zs;
+    parse_obj_file(obj_file, indices, xs, ys, zs);
+    return add(*new TriangleMesh(std::move(xs), std::move(ys), std::move(zs), std::move(indices)), material);
+}
 
-            delete node;
-        }
+const Mesh &Scene::mesh(const std::string &obj_file) {
+    auto iter = _meshes.find(obj_file);
+    if (iter != _meshes.end()) {
+        return *iter->second;
     }
+    std::vector<uint32_t> indices;
+    std::vector<float> xs, ys, zs;
+    parse_obj_file(obj_file, indices, xs, ys, zs);
+    Mesh *mesh = new Mesh(TriangleMesh{std::move(xs), std::move(ys), std::move(zs), std::move(indices)},
+                          _config.leaf_size());
+    _meshes[obj_file] = mesh;
+    return *mesh;
 }
 
-Sphere &Scene::sphere(float x, float y, float z, float radius, const Material &material) {
-    Sphere *surface = new Sphere(x, y, z, radius);
-    surface->material(material);
-    _surfaces.push_back(surface);
-    return *surface;
+Instance &Scene::instance(const Mesh &mesh, const Transform &transform, const Material &material) {
+    return add(*new Instance(mesh, transform), material);
 }
 
-Triangle &Scene::triangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3,
-                          float z3, const Material &material) {
-    Triangle *surface = new Triangle(x1, y1, z1, x2, y2, z2, x3, y3, z3);
-    surface->material(material);
-    _surfaces.push_back(surface);
-    return *surface;
+void Scene::remove(const Surface &surface) {
+    auto iter = _positions.find(&surface);
+    if (iter == _positions.end()) {
+        throw RenderException("The surface to remove is not in this scene");
+    }
+    Surface *removed = _surfaces[iter->second];
+    _surfaces[iter->second] = nullptr;
+    _positions.erase(iter);
+    ++_removed_num;
+    // the slot in a store is only overwritten by the next surface added, its material entry is freed now
+    removed->materials(nullptr);
+    if (!_spheres.remove(*removed) && !_triangles.remove(*removed)) {
+        delete removed;
+    }
+    _prims_dirty = true;
+}
+
+void Scene::surface_changed(const Surface &surface) {
+    if (!surface.bounded()) {
+        // unbounded surfaces are not in the tree
+        return;
+    }
+    // a tree built over the surface can be refitted, anything else waits for the next build
+    auto iter = _first_prim.find(&surface);
+    if (_prims_dirty || _accel_dirty || iter == _first_prim.end()) {
+        _accel_dirty = true;
+    } else {
+        for (uint32_t i = 0; i < surface.prim_num(); ++i) {
+            _changed.push_back(iter->second + i);
+        }
+        if (_changed.size() > 2 * static_cast<size_t>(_bounded_num)) {
+            // surfaces moved again before the next refit, e.g. in every frame of an animation rendered without
+            // the tree, drop the repeats so the list stays within twice the number of primitives
+            std::sort(_changed.begin(), _changed.end());
+            _changed.erase(std::unique(_changed.begin(), _changed.end()), _changed.end());
+        }
+    }
 }
 
 PointLight &Scene::pointLight(float x, float y, float z, float r, float g, float b) {
@@ -289,7 +431,14 @@ AmbientLight &Scene::ambientLight(float r, float g, float b) {
 
 Scene::~Scene() {
     for (auto &elem : _surfaces) {
-        delete elem;
+        // spheres and triangles are owned by their stores
+        if (elem && elem->prim_type() != PrimType::SPHERE && elem->prim_type() != PrimType::TRIANGLE) {
+            delete elem;
+        }
+    }
+
+    for (auto &elem : _meshes) {
+        delete elem.second;
     }
 
     for (auto &elem : _lights) {
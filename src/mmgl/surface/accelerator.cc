@@ -0,0 +1,51 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/accelerator.h"
+
+namespace mmgl {
+
+void Accelerator::build(const std::vector<BBox> &boxes, const BVH &bvh_mode, unsigned width, unsigned leaf_size,
+                        task_pool *pool, const BoxClipper &clip) {
+    clear();
+    _bvh_mode = bvh_mode;
+    _width = width;
+    _leaf_size = leaf_size;
+    _bvh.build(boxes, bvh_mode, leaf_size, pool, clip);
+    if (_width != 2) {
+        _wide_bvh.build(_bvh, _width);
+    }
+}
+
+bool Accelerator::refit(const std::function<BBox(uint32_t)> &box_of, const std::vector<uint32_t> &changed,
+                        float threshold, task_pool *pool) {
+    if (!_bvh.refittable()) {
+        return false;
+    }
+    _bvh.refit(box_of, changed, pool, _updated);
+    if (threshold > 0 && _bvh.sah_cost() > threshold * _bvh.build_cost()) {
+        return false;
+    }
+    if (_width != 2) {
+        _wide_bvh.refit(_bvh, _updated);
+    }
+    return true;
+}
+
+BVHStats Accelerator::stats() const {
+    BVHStats stats = _bvh.stats();
+    if (_width != 2) {
+        stats.wide_node_num = _wide_bvh.node_num();
+        stats.memory += _wide_bvh.memory();
+    }
+    return stats;
+}
+
+void Accelerator::clear() {
+    _bvh.clear();
+    _wide_bvh.clear();
+}
+
+}
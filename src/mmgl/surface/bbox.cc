@@ -8,6 +8,9 @@
 namespace mmgl {
 
 std::pair<bool, float> BBox::intersect(const Ray &ray, bool isNode) const {
+    if (RenderStats *stats = ray.stats()) {
+        stats->box_tests++;
+    }
     std::pair<bool, float> ret{false, .0f};
     const Vector &ray_dir = ray._dir;
     const Point &ray_orig = ray._origin;
@@ -87,6 +90,36 @@ void BBox::box(float x_min, float y_min, float z_min, float x_max, float y_max,
     _max._z = z_max + BOUNDING;
 }
 
+void BBox::merge(const BBox &other) {
+    _min._x = std::min(_min._x, other._min._x);
+    _min._y = std::min(_min._y, other._min._y);
+    _min._z = std::min(_min._z, other._min._z);
+
+    _max._x = std::max(_max._x, other._max._x);
+    _max._y = std::max(_max._y, other._max._y);
+    _max._z = std::max(_max._z, other._max._z);
+}
+
+BBox BBox::overlap(const BBox &other) const {
+    BBox ret{std::max(_min._x, other._min._x), std::max(_min._y, other._min._y), std::max(_min._z, other._min._z),
+             std::min(_max._x, other._max._x), std::min(_max._y, other._max._y), std::min(_max._z, other._max._z)};
+    return ret.valid() ? ret : empty();
+}
+
+float BBox::area() const {
+    float dx = _max._x - _min._x, dy = _max._y - _min._y, dz = _max._z - _min._z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+float BBox::volume() const {
+    return (_max._x - _min._x) * (_max._y - _min._y) * (_max._z - _min._z);
+}
+
+BBox BBox::empty() {
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    return BBox{inf, inf, inf, -inf, -inf, -inf};
+}
+
 Vector BBox::normal(const Point &inter_p) const {
     Vector ret(.0f, .0f, .0f);
 
@@ -0,0 +1,131 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/instance.h"
+
+namespace mmgl {
+
+Instance::Instance(const Mesh &mesh, const Transform &transform) : _mesh{&mesh}, _to_world{transform} {
+    init();
+}
+
+void Instance::init() {
+    _to_object = _to_world.inverse();
+
+    // world box around the eight transformed corners of the mesh box
+    const BBox &box = _mesh->box();
+    BBox bounds = BBox::empty();
+    for (int corner = 0; corner < 8; ++corner) {
+        Point p = _to_world.apply(Point{corner & 1 ? box.max().x() : box.min().x(),
+                                        corner & 2 ? box.max().y() : box.min().y(),
+                                        corner & 4 ? box.max().z() : box.min().z()});
+        bounds.merge(BBox{p.x(), p.y(), p.z(), p.x(), p.y(), p.z()});
+    }
+    Surface::box(bounds.min().x(), bounds.min().y(), bounds.min().z(),
+                 bounds.max().x(), bounds.max().y(), bounds.max().z());
+}
+
+bool Instance::intersect(Ray &ray, const Render &flag) const {
+    return box_only(flag) ? intersect<Render::BBOX_ONLY>(ray) : intersect<Render::NORMAL>(ray);
+}
+
+template<Render R>
+bool Instance::intersect(Ray &ray) const {
+    // rays may start inside the box of a whole mesh, so test it like a BVH node
+    std::pair<bool, float> box_hit = box_intersect(ray, true);
+    if (!box_hit.first) {
+        return false;
+    }
+    if (box_only<R>()) {
+        if (ray.updatable(box_hit.second)) {
+            ray.hit(Hit{box_hit.second, this, 0, 0, 0});
+        }
+        return true;
+    }
+
+    if (ray.has_intersect() && ray.hit().t < box_hit.second) {
+        // skip intersection computation if bbox distance is larger than closest intersection point
+        return true;
+    }
+
+    // the direction is not renormalized, so t is the same in both spaces
+    Ray local{_to_object.apply(ray.origin()), _to_object.apply(ray.dir())};
+    local.stats(ray.stats());
+    if (ray.has_intersect()) {
+        local.hit(Hit{ray.hit().t, nullptr, 0, 0, 0});
+    }
+    if (ray.start_id() == this) {
+        // only the triangle the ray leaves is skipped, the rest of this instance can still be hit
+        local.start_at(&_mesh->triangles(), ray.start_prim());
+    }
+    if (!_mesh->intersect<R>(local)) {
+        return false;
+    }
+
+    const Hit &hit = local.hit();
+    if (hit.id && ray.updatable(hit.t)) {
+        // the prim is the mesh triangle, so rays leaving this instance can skip just that triangle
+        ray.hit(Hit{hit.t, this, hit.prim, hit.u, hit.v});
+    }
+    return true;
+}
+
+Vector Instance::normal(const Hit &hit, const Point &point) const {
+    Vector norm = _to_object.apply_transposed(_mesh->triangles().normal(hit, _to_object.apply(point)));
+    norm.normalize();
+    return norm;
+}
+
+bool Instance::occluded(const Ray &ray, const Render &flag, uint32_t, float t_max) const {
+    return box_only(flag) ? occluded<Render::BBOX_ONLY>(ray, t_max) : occluded<Render::NORMAL>(ray, t_max);
+}
+
+template<Render R>
+bool Instance::occluded(const Ray &ray, float t_max) const {
+    std::pair<bool, float> box_hit = box_intersect(ray, true);
+    if (!box_hit.first) {
+        return false;
+    }
+    if (box_only<R>()) {
+        // blocked where intersect<R> would record the box hit
+        return box_hit.second > EPS && box_hit.second < t_max;
+    }
+    Ray local{_to_object.apply(ray.origin()), _to_object.apply(ray.dir())};
+    local.stats(ray.stats());
+    if (ray.start_id() == this) {
+        local.start_at(&_mesh->triangles(), ray.start_prim());
+    }
+    return _mesh->occluded<R>(local, t_max);
+}
+
+template bool Instance::intersect<Render::NORMAL>(Ray &) const;
+template bool Instance::intersect<Render::BBOX_ONLY>(Ray &) const;
+template bool Instance::intersect<Render::BVH_BBOX_ONLY>(Ray &) const;
+template bool Instance::intersect<Render::BVH>(Ray &) const;
+template bool Instance::occluded<Render::NORMAL>(const Ray &, float) const;
+template bool Instance::occluded<Render::BBOX_ONLY>(const Ray &, float) const;
+template bool Instance::occluded<Render::BVH_BBOX_ONLY>(const Ray &, float) const;
+template bool Instance::occluded<Render::BVH>(const Ray &, float) const;
+
+std::string Instance::to_string() const {
+    std::stringstream os;
+    os << "Instance:\n";
+    os << "\ttriangles: " << _mesh->size() << "\n";
+    os << "\t" << _to_world << std::flush;
+    return os.str();
+}
+
+Instance &Instance::transform(const Transform &transform) {
+    _to_world = transform;
+    init();
+    return *this;
+}
+
+Instance &Instance::made_of(const Material &material) {
+    Surface::material(material);
+    return *this;
+}
+
+}
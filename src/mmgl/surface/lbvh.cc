@@ -0,0 +1,311 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/linear_bvh.h"
+#include "mmgl/util/thread_pool.h"
+
+#define LBVH_GRAIN 16384
+#define LBVH_LEAF_FLAG 0x80000000u
+
+namespace mmgl {
+
+namespace {
+
+/**
+ * Run f(chunk_begin, chunk_end) over [begin, end), on the pool if there is one.
+ */
+template<typename Function>
+void for_range(task_pool *pool, size_t begin, size_t end, size_t grain, Function f) {
+    if (pool && end - begin > grain) {
+        pool->parallel_for(begin, end, grain, f);
+    } else {
+        f(begin, end);
+    }
+}
+
+/**
+ * Spread the lower 21 bits of v so that two zero bits follow every bit.
+ */
+inline uint64_t expand_bits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+inline int count_leading_zeros(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return v ? __builtin_clzll(v) : 64;
+#else
+    int n = 0;
+    for (uint64_t bit = 1ull << 63; bit && !(v & bit); bit >>= 1) {
+        ++n;
+    }
+    return n;
+#endif
+}
+
+/**
+ * Stable LSD radix sort of keys and their primitive indices, 8 bits per pass.
+ * Every pass builds per-chunk digit histograms and scatters the chunks in parallel.
+ */
+void radix_sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &indices, int bits, task_pool *pool) {
+    const size_t n = keys.size();
+    const size_t chunk_num = pool ? (n + LBVH_GRAIN - 1) / LBVH_GRAIN : 1;
+    const size_t chunk_size = (n + chunk_num - 1) / chunk_num;
+    std::vector<uint64_t> keys_tmp(n);
+    std::vector<uint32_t> indices_tmp(n);
+    std::vector<size_t> offsets(chunk_num * 256);
+
+    for (int shift = 0; shift < bits; shift += 8) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for_range(pool, 0, chunk_num, 1, [&](size_t c_begin, size_t c_end) {
+            for (size_t c = c_begin; c < c_end; ++c) {
+                size_t *histogram = &offsets[c * 256];
+                for (size_t i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size); ++i) {
+                    histogram[(keys[i] >> shift) & 0xff]++;
+                }
+            }
+        });
+
+        // exclusive prefix over (digit, chunk), which keeps the sort stable
+        size_t sum = 0;
+        bool single_digit = false;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t digit_sum = 0;
+            for (size_t c = 0; c < chunk_num; ++c) {
+                size_t count = offsets[c * 256 + digit];
+                offsets[c * 256 + digit] = sum;
+                sum += count;
+                digit_sum += count;
+            }
+            single_digit = single_digit || digit_sum == n;
+        }
+        if (single_digit) {
+            // all keys share this digit, nothing moves
+            continue;
+        }
+
+        for_range(pool, 0, chunk_num, 1, [&](size_t c_begin, size_t c_end) {
+            for (size_t c = c_begin; c < c_end; ++c) {
+                size_t *offset = &offsets[c * 256];
+                for (size_t i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size); ++i) {
+                    size_t position = offset[(keys[i] >> shift) & 0xff]++;
+                    keys_tmp[position] = keys[i];
+                    indices_tmp[position] = indices[i];
+                }
+            }
+        });
+        keys.swap(keys_tmp);
+        indices.swap(indices_tmp);
+    }
+}
+
+/**
+ * Binary radix tree over sorted keys (Karras 2012). Internal node i is computed independently of all
+ * other nodes, duplicate keys are told apart by their position.
+ */
+class RadixTree {
+public:
+    explicit RadixTree(const std::vector<uint64_t> &keys)
+            : _keys(keys), _n{static_cast<long>(keys.size())},
+              left(keys.size() - 1), right(keys.size() - 1), first(keys.size() - 1), last(keys.size() - 1),
+              axis(keys.size() - 1) { }
+
+    void internal(long i) {
+        int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+
+        // upper bound of the range length, then binary search its other end
+        int delta_min = delta(i, i - d);
+        long l_max = 2;
+        while (delta(i, i + l_max * d) > delta_min) {
+            l_max *= 2;
+        }
+        long l = 0;
+        for (long t = l_max / 2; t >= 1; t /= 2) {
+            if (delta(i, i + (l + t) * d) > delta_min) {
+                l += t;
+            }
+        }
+        long j = i + l * d;
+
+        // binary search the split position
+        int delta_node = delta(i, j);
+        long s = 0;
+        long t = l;
+        do {
+            t = (t + 1) / 2;
+            if (delta(i, i + (s + t) * d) > delta_node) {
+                s += t;
+            }
+        } while (t > 1);
+        long gamma = i + s * d + std::min(d, 0);
+
+        left[i] = static_cast<uint32_t>(gamma) | (std::min(i, j) == gamma ? LBVH_LEAF_FLAG : 0);
+        right[i] = static_cast<uint32_t>(gamma + 1) | (std::max(i, j) == gamma + 1 ? LBVH_LEAF_FLAG : 0);
+        first[i] = static_cast<uint32_t>(std::min(i, j));
+        last[i] = static_cast<uint32_t>(std::max(i, j));
+        // Morton bits interleave x, y, z from the lowest bit on, the first differing bit is the split axis
+        axis[i] = static_cast<uint8_t>(delta_node < 64 ? (63 - delta_node) % 3 : 0);
+    }
+
+private:
+    /**
+     * Length of the common prefix of keys i and j, -1 if j is out of range.
+     */
+    inline int delta(long i, long j) const {
+        if (j < 0 || j >= _n) {
+            return -1;
+        }
+        if (_keys[i] == _keys[j]) {
+            return 64 + count_leading_zeros(static_cast<uint64_t>(i ^ j) << 32);
+        }
+        return count_leading_zeros(_keys[i] ^ _keys[j]);
+    }
+
+    const std::vector<uint64_t> &_keys;
+    long _n;
+
+public:
+    std::vector<uint32_t> left;
+    std::vector<uint32_t> right;
+    std::vector<uint32_t> first;  // sorted primitives covered by the node, inclusive
+    std::vector<uint32_t> last;
+    std::vector<uint8_t> axis;
+};
+
+}
+
+void LinearBVH::build_lbvh(const std::vector<BBox> &boxes, unsigned leaf_size, task_pool *pool) {
+    const size_t n = boxes.size();
+
+    // bounds of the box centroids, the Morton grid spans them
+    const size_t chunk_num = (n + LBVH_GRAIN - 1) / LBVH_GRAIN;
+    std::vector<BBox> chunk_bounds(chunk_num, BBox::empty());
+    for_range(pool, 0, n, LBVH_GRAIN, [&](size_t begin, size_t end) {
+        BBox &bounds = chunk_bounds[begin / LBVH_GRAIN];
+        for (size_t i = begin; i < end; ++i) {
+            const BBox &box = boxes[i];
+            bounds.merge(BBox{box.center(0), box.center(1), box.center(2),
+                              box.center(0), box.center(1), box.center(2)});
+        }
+    });
+    BBox centroids = BBox::empty();
+    for (const BBox &bounds : chunk_bounds) {
+        centroids.merge(bounds);
+    }
+
+    // 10 bits per axis fit 30-bit keys, large meshes get 21 bits per axis
+    const int axis_bits = n > LBVH_WIDE_KEY_THRESHOLD ? 21 : 10;
+    const float cells = static_cast<float>((1u << axis_bits) - 1);
+    float scale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = centroids.max()[axis] - centroids.min()[axis];
+        scale[axis] = extent > .0f ? cells / extent : .0f;
+    }
+
+    std::vector<uint64_t> keys(n);
+    std::vector<uint32_t> indices(n);
+    for_range(pool, 0, n, LBVH_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t code = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                float cell = (boxes[i].center(axis) - centroids.min()[axis]) * scale[axis];
+                code |= expand_bits(static_cast<uint64_t>(std::min(std::max(cell, .0f), cells))) << axis;
+            }
+            keys[i] = code;
+            indices[i] = static_cast<uint32_t>(i);
+        }
+    });
+    radix_sort(keys, indices, 3 * axis_bits, pool);
+    _order.swap(indices);
+
+    _nodes.resize(2 * n - 1);
+    if (n == 1) {
+        const BBox &box = boxes[_order[0]];
+        LinearBVHNode leaf{};
+        for (int axis = 0; axis < 3; ++axis) {
+            leaf.min[axis] = box.min()[axis];
+            leaf.max[axis] = box.max()[axis];
+        }
+        leaf.prim_num = 1;
+        _nodes[0] = leaf;
+        return;
+    }
+
+    // every internal node of the radix tree is independent of all others
+    RadixTree tree{keys};
+    for_range(pool, 0, n - 1, LBVH_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            tree.internal(static_cast<long>(i));
+        }
+    });
+
+    // emit in depth-first order, a pending right child carries the node waiting for its offset.
+    // A node covering no more than leaf_size primitives becomes a leaf over its whole range
+    const uint32_t leaf_span = leaf_size - 1;
+    struct Pending {
+        uint32_t ref;
+        uint32_t parent;
+    };
+    std::vector<Pending> stack{Pending{0, UINT32_MAX}};
+    uint32_t emitted = 0;
+    while (!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        uint32_t index = emitted++;
+        if (pending.parent != UINT32_MAX) {
+            _nodes[pending.parent].offset = index;
+        }
+
+        LinearBVHNode &node = _nodes[index];
+        node = LinearBVHNode{};
+        bool leaf = (pending.ref & LBVH_LEAF_FLAG) != 0;
+        uint32_t begin = pending.ref & ~LBVH_LEAF_FLAG;
+        uint32_t end = begin + 1;
+        if (!leaf && tree.last[pending.ref] - tree.first[pending.ref] <= leaf_span) {
+            leaf = true;
+            begin = tree.first[pending.ref];
+            end = tree.last[pending.ref] + 1;
+        }
+        if (leaf) {
+            BBox bounds = BBox::empty();
+            for (uint32_t position = begin; position < end; ++position) {
+                bounds.merge(boxes[_order[position]]);
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                node.min[axis] = bounds.min()[axis];
+                node.max[axis] = bounds.max()[axis];
+            }
+            node.offset = begin;
+            node.prim_num = static_cast<uint16_t>(end - begin);
+        } else {
+            node.axis = tree.axis[pending.ref];
+            stack.push_back(Pending{tree.right[pending.ref], index});
+            stack.push_back(Pending{tree.left[pending.ref], UINT32_MAX});
+        }
+    }
+
+    _nodes.resize(emitted);
+
+    // children always follow their parent, so a reverse sweep fills in the bounds bottom-up
+    for (size_t i = _nodes.size(); i-- > 0;) {
+        LinearBVHNode &node = _nodes[i];
+        if (node.prim_num > 0) {
+            continue;
+        }
+        const LinearBVHNode &first = _nodes[i + 1];
+        const LinearBVHNode &second = _nodes[node.offset];
+        for (int axis = 0; axis < 3; ++axis) {
+            node.min[axis] = std::min(first.min[axis], second.min[axis]);
+            node.max[axis] = std::max(first.max[axis], second.max[axis]);
+        }
+    }
+}
+
+}
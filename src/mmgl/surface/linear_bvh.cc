@@ -0,0 +1,544 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/linear_bvh.h"
+#include "mmgl/util/thread_pool.h"
+
+namespace mmgl {
+
+namespace {
+
+/**
+ * Primitive reference used while building, the index points back into the boxes passed to build().
+ */
+struct BuildPrimitive {
+    BBox box;
+    uint32_t index;
+};
+
+/**
+ * Function object for comparing bounding boxes along an axis.
+ */
+struct BBoxComparable {
+    int _axis;
+
+    BBoxComparable(int axis = 0) : _axis{axis} { }
+
+    bool operator()(const BuildPrimitive &l, const BuildPrimitive &r) const {
+        // ties broken by index, a total order keeps parallel and serial sorts identical
+        float lv = l.box.min()[_axis], rv = r.box.min()[_axis];
+        return lv < rv || (lv == rv && l.index < r.index);
+    }
+};
+
+/**
+ * Top-down builder writing nodes straight into depth-first order.
+ * With a thread pool, large subtrees are built as tasks into their own node arrays and spliced back
+ * in depth-first position, and the bounds, binning and sort work of large ranges is split into chunks,
+ * so the tree comes out identical to the serial build.
+ */
+class LinearBVHBuilder {
+public:
+    LinearBVHBuilder(std::vector<BuildPrimitive> &prims, const BVH &bvh_mode, unsigned leaf_size, task_pool *pool)
+            : _prims(prims), _bvh_mode{bvh_mode}, _leaf_size{leaf_size}, _pool{pool} { }
+
+    /**
+     * Build the subtree over [begin, end) of the primitives into nodes, return the index of its root node.
+     */
+    uint32_t build(size_t begin, size_t end, int depth, std::vector<LinearBVHNode> &nodes);
+
+private:
+    inline bool parallel(size_t begin, size_t end) const {
+        return _pool && end - begin >= BVH_PARALLEL_THRESHOLD;
+    }
+
+    /**
+     * Map [begin, end) chunk by chunk and fold the results in chunk order.
+     */
+    template<typename T, typename Map, typename Reduce>
+    T reduce(size_t begin, size_t end, Map map, Reduce fold);
+
+    BBox compute_bounds(size_t begin, size_t end);
+
+    /**
+     * Sort the range along the longest axis of bounds and return the cut position.
+     */
+    size_t sort_cut(size_t begin, size_t end, const BBox &bounds, int &axis, bool volume_cut);
+
+    void sort(size_t begin, size_t end, int axis);
+
+    /**
+     * Helper function for determining the volume based cut position, a binary search over compute_volume.
+     */
+    size_t determine_cut(size_t begin, size_t end);
+
+    float compute_volume(size_t begin, size_t end);
+
+    /**
+     * Bin the box centroids along all three axes, pick the cheapest split plane and partition the range
+     * around it, no sorting involved.
+     * @param cost Receives the summed area times count of both sides, infinite if no plane separates the range.
+     */
+    size_t sah_cut(size_t begin, size_t end, int &axis, float &cost);
+
+    std::vector<BuildPrimitive> &_prims;
+    BVH _bvh_mode;
+    size_t _leaf_size;
+    task_pool *_pool;
+};
+
+/**
+ * Centroid bounds and bins of a range along one axis, merged chunk by chunk during SAH binning.
+ */
+struct SAHBins {
+    size_t counts[SAH_BIN_NUM];
+    BBox boxes[SAH_BIN_NUM];
+
+    SAHBins() : counts{} {
+        std::fill(boxes, boxes + SAH_BIN_NUM, BBox::empty());
+    }
+
+    void merge(const SAHBins &other) {
+        for (int b = 0; b < SAH_BIN_NUM; ++b) {
+            counts[b] += other.counts[b];
+            boxes[b].merge(other.boxes[b]);
+        }
+    }
+};
+
+template<typename T, typename Map, typename Reduce>
+T LinearBVHBuilder::reduce(size_t begin, size_t end, Map map, Reduce fold) {
+    if (!parallel(begin, end)) {
+        return map(begin, end);
+    }
+    size_t chunk = BVH_PARALLEL_THRESHOLD / 2;
+    std::vector<std::future<T>> futures;
+    for (size_t b = begin + chunk; b < end; b += chunk) {
+        size_t e = std::min(b + chunk, end);
+        futures.push_back(_pool->submit([=]() { return map(b, e); }));
+    }
+    T result = map(begin, begin + chunk);
+    for (auto &f : futures) {
+        _pool->wait(f);
+        fold(result, f.get());
+    }
+    return result;
+}
+
+uint32_t LinearBVHBuilder::build(size_t begin, size_t end, int depth, std::vector<LinearBVHNode> &nodes) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    BBox bounds = compute_bounds(begin, end);
+
+    LinearBVHNode node{};
+    for (int axis = 0; axis < 3; ++axis) {
+        node.min[axis] = bounds.min()[axis];
+        node.max[axis] = bounds.max()[axis];
+    }
+
+    // the SAH modes weigh a leaf against the best split, the others stop at the leaf size
+    size_t count = end - begin;
+    bool leaf = count == 1 || (count <= _leaf_size && (_bvh_mode != BVH::SAH || depth >= BVH_MAX_CUT_DEPTH));
+    int axis = 0;
+    size_t median = 0;
+    if (!leaf) {
+        if (depth >= BVH_MAX_CUT_DEPTH) {
+            // bound the depth, so the traversal stack never overflows
+            median = sort_cut(begin, end, bounds, axis, false);
+        } else if (_bvh_mode == BVH::SAH) {
+            float split_cost;
+            median = sah_cut(begin, end, axis, split_cost);
+            leaf = count <= _leaf_size && count * bounds.area() <= SAH_TRAVERSAL_COST * bounds.area() + split_cost;
+        } else {
+            median = sort_cut(begin, end, bounds, axis, _bvh_mode == BVH::VOLUME_CUT);
+        }
+    }
+
+    if (leaf) {
+        node.offset = static_cast<uint32_t>(begin);
+        node.prim_num = static_cast<uint16_t>(count);
+        nodes[index] = node;
+        return index;
+    }
+
+    if (parallel(begin, end)) {
+        // left subtree as a task, right one here, then splice both behind this node
+        std::vector<LinearBVHNode> left_nodes;
+        std::vector<LinearBVHNode> right_nodes;
+        auto left = _pool->submit([&]() { build(begin, median, depth + 1, left_nodes); });
+        build(median, end, depth + 1, right_nodes);
+        _pool->wait(left);
+        left.get();
+
+        for (std::vector<LinearBVHNode> *sub : {&left_nodes, &right_nodes}) {
+            uint32_t base = static_cast<uint32_t>(nodes.size());
+            for (LinearBVHNode &sub_node : *sub) {
+                if (sub_node.prim_num == 0) {
+                    sub_node.offset += base;
+                }
+                nodes.push_back(sub_node);
+            }
+        }
+        node.offset = index + 1 + static_cast<uint32_t>(left_nodes.size());
+    } else {
+        build(begin, median, depth + 1, nodes);
+        node.offset = build(median, end, depth + 1, nodes);
+    }
+    node.axis = static_cast<uint8_t>(axis);
+    nodes[index] = node;
+    return index;
+}
+
+BBox LinearBVHBuilder::compute_bounds(size_t begin, size_t end) {
+    return reduce<BBox>(begin, end, [this](size_t b, size_t e) {
+        BBox bounds = BBox::empty();
+        for (size_t i = b; i < e; ++i) {
+            bounds.merge(_prims[i].box);
+        }
+        return bounds;
+    }, [](BBox &result, const BBox &chunk) {
+        result.merge(chunk);
+    });
+}
+
+void LinearBVHBuilder::sort(size_t begin, size_t end, int axis) {
+    auto first = _prims.begin() + begin, last = _prims.begin() + end;
+    if (!parallel(begin, end)) {
+        std::sort(first, last, BBoxComparable{axis});
+        return;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    auto left = _pool->submit([=]() { sort(begin, middle, axis); });
+    sort(middle, end, axis);
+    _pool->wait(left);
+    left.get();
+    std::inplace_merge(first, _prims.begin() + middle, last, BBoxComparable{axis});
+}
+
+size_t LinearBVHBuilder::sort_cut(size_t begin, size_t end, const BBox &bounds, int &axis, bool volume_cut) {
+    float x_span = bounds.max().x() - bounds.min().x();
+    float y_span = bounds.max().y() - bounds.min().y();
+    float z_span = bounds.max().z() - bounds.min().z();
+    axis = 0;
+    if (y_span > z_span && y_span > x_span) {
+        axis = 1;
+    } else if (z_span > x_span && z_span > y_span) {
+        axis = 2;
+    }
+    sort(begin, end, axis);
+
+    if (volume_cut) {
+        // volume based cut --- binary search
+        return determine_cut(begin, end);
+    } else {
+        // count based cut
+        return begin + (end - begin) / 2;
+    }
+}
+
+size_t LinearBVHBuilder::determine_cut(size_t begin, size_t end) {
+    size_t size = end - begin;
+    size_t median = size / 2;
+    size_t first = 0, last = size;
+    size_t prev_median = 0;
+    while (median > 1 && median < size - 1 && prev_median != median) {
+        float left = compute_volume(begin, begin + median);
+        float right = compute_volume(begin + median, end);
+        if (left >= right) {
+            last = median;
+        } else {
+            first = median;
+        }
+        prev_median = median;
+        median = (first + last) / 2;
+    }
+    return begin + median;
+}
+
+float LinearBVHBuilder::compute_volume(size_t begin, size_t end) {
+    return compute_bounds(begin, end).volume();
+}
+
+size_t LinearBVHBuilder::sah_cut(size_t begin, size_t end, int &axis, float &cost) {
+    constexpr float inf = std::numeric_limits<float>::infinity();
+
+    // bounds of the box centroids, splitting planes are placed inside of it
+    BBox centroids = reduce<BBox>(begin, end, [this](size_t b, size_t e) {
+        BBox bounds = BBox::empty();
+        for (size_t i = b; i < e; ++i) {
+            const BBox &box = _prims[i].box;
+            bounds.merge(BBox{box.center(0), box.center(1), box.center(2),
+                              box.center(0), box.center(1), box.center(2)});
+        }
+        return bounds;
+    }, [](BBox &result, const BBox &chunk) {
+        result.merge(chunk);
+    });
+    const float c_min[3] = {centroids.min().x(), centroids.min().y(), centroids.min().z()};
+    const float c_max[3] = {centroids.max().x(), centroids.max().y(), centroids.max().z()};
+
+    int best_axis = -1;
+    int best_split = 0;
+    float best_cost = inf;
+    for (int k = 0; k < 3; ++k) {
+        float extent = c_max[k] - c_min[k];
+        if (extent <= .0f) {
+            continue;
+        }
+        float c_low = c_min[k];
+        float scale = SAH_BIN_NUM / extent;
+
+        SAHBins bins = reduce<SAHBins>(begin, end, [=](size_t b, size_t e) {
+            SAHBins chunk;
+            for (size_t i = b; i < e; ++i) {
+                int bin = std::min(static_cast<int>((_prims[i].box.center(k) - c_low) * scale), SAH_BIN_NUM - 1);
+                chunk.counts[bin]++;
+                chunk.boxes[bin].merge(_prims[i].box);
+            }
+            return chunk;
+        }, [](SAHBins &result, const SAHBins &chunk) {
+            result.merge(chunk);
+        });
+        const size_t *counts = bins.counts;
+        const BBox *boxes = bins.boxes;
+
+        // sweep from the right to get area * count of every right side, then from the left to get the cost
+        float right_cost[SAH_BIN_NUM];
+        size_t count = 0;
+        BBox acc = BBox::empty();
+        for (int b = SAH_BIN_NUM - 1; b > 0; --b) {
+            count += counts[b];
+            acc.merge(boxes[b]);
+            right_cost[b] = count ? acc.area() * count : .0f;
+        }
+        count = 0;
+        acc = BBox::empty();
+        for (int b = 0; b < SAH_BIN_NUM - 1; ++b) {
+            count += counts[b];
+            acc.merge(boxes[b]);
+            float cost = (count ? acc.area() * count : .0f) + right_cost[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = k;
+                best_split = b + 1;
+            }
+        }
+    }
+
+    auto first = _prims.begin() + begin, last = _prims.begin() + end;
+    auto median = first;
+    if (best_axis >= 0) {
+        int k = best_axis;
+        float c_low = c_min[k];
+        float scale = SAH_BIN_NUM / (c_max[k] - c_low);
+        median = std::partition(first, last, [=](const BuildPrimitive &prim) {
+            return std::min(static_cast<int>((prim.box.center(k) - c_low) * scale), SAH_BIN_NUM - 1) < best_split;
+        });
+    }
+    axis = best_axis >= 0 ? best_axis : 0;
+    cost = best_cost;
+    if (median == first || median == last) {
+        // all centroids fall into one bin, fall back to a count cut
+        median = first + (last - first) / 2;
+        std::nth_element(first, median, last, BBoxComparable{axis});
+    }
+    return median - _prims.begin();
+}
+
+}
+
+void LinearBVH::build(const std::vector<BBox> &boxes, const BVH &bvh_mode, unsigned leaf_size,
+                      task_pool *pool, const BoxClipper &clip) {
+    clear();
+    if (boxes.empty()) {
+        return;
+    }
+    leaf_size = std::min(std::max(leaf_size, 1u), static_cast<unsigned>(BVH_MAX_LEAF_SIZE));
+    if (bvh_mode == BVH::LBVH) {
+        build_lbvh(boxes, leaf_size, pool);
+    } else if (bvh_mode == BVH::SBVH) {
+        build_sbvh(boxes, leaf_size, clip ? clip : [&boxes](uint32_t i, const BBox &bounds) {
+            return boxes[i].overlap(bounds);
+        }, pool);
+    } else {
+        std::vector<BuildPrimitive> prims;
+        prims.reserve(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            prims.push_back(BuildPrimitive{boxes[i], static_cast<uint32_t>(i)});
+        }
+
+        _nodes.reserve(2 * boxes.size() - 1);
+        LinearBVHBuilder builder{prims, bvh_mode, leaf_size, pool};
+        builder.build(0, prims.size(), 0, _nodes);
+
+        _order.reserve(prims.size());
+        for (const BuildPrimitive &prim : prims) {
+            _order.push_back(prim.index);
+        }
+    }
+
+    link(boxes.size());
+    _build_cost = sah_cost();
+}
+
+void LinearBVH::renumber() {
+    if (!refittable()) {
+        throw RenderException("A BVH with spatial splits cannot be renumbered");
+    }
+    for (uint32_t i = 0; i < _order.size(); ++i) {
+        _order[i] = i;
+    }
+    link(_order.size());
+}
+
+void LinearBVH::link(size_t prim_num) {
+    _parents.assign(_nodes.size(), 0);
+    _leaf_of.assign(prim_num, 0);
+    _area_sum = 0;
+    for (uint32_t i = 0; i < _nodes.size(); ++i) {
+        const LinearBVHNode &node = _nodes[i];
+        _area_sum += weighted_area(node);
+        if (node.prim_num == 0) {
+            _parents[i + 1] = i;
+            _parents[node.offset] = i;
+        } else {
+            for (uint32_t p = node.offset; p < node.offset + node.prim_num; ++p) {
+                _leaf_of[_order[p]] = i;
+            }
+        }
+    }
+}
+
+float LinearBVH::sah_cost() const {
+    if (_nodes.empty()) {
+        return .0f;
+    }
+    double root_area = weighted_area(_nodes[0]) / (_nodes[0].prim_num ? _nodes[0].prim_num : 1);
+    return root_area > 0 ? static_cast<float>(_area_sum / root_area) : .0f;
+}
+
+BVHStats LinearBVH::stats() const {
+    BVHStats stats;
+    stats.node_num = _nodes.size();
+    stats.reference_num = _order.size();
+    stats.sah_cost = sah_cost();
+    stats.memory = _nodes.capacity() * sizeof(LinearBVHNode) +
+                   (_order.capacity() + _parents.capacity() + _leaf_of.capacity()) * sizeof(uint32_t);
+
+    // children follow their parent, so depths come out of one forward sweep
+    std::vector<int> depth(_nodes.size(), 0);
+    size_t depth_sum = 0;
+    for (uint32_t i = 0; i < _nodes.size(); ++i) {
+        if (i > 0) {
+            depth[i] = depth[_parents[i]] + 1;
+        }
+        if (_nodes[i].prim_num > 0) {
+            stats.leaf_num++;
+            stats.max_depth = std::max(stats.max_depth, depth[i]);
+            depth_sum += depth[i];
+        }
+    }
+    stats.avg_depth = stats.leaf_num ? static_cast<float>(depth_sum) / stats.leaf_num : .0f;
+    return stats;
+}
+
+bool LinearBVH::refit_node(uint32_t index, const std::function<BBox(uint32_t)> &box_of) {
+    LinearBVHNode &node = _nodes[index];
+    BBox bounds = BBox::empty();
+    if (node.prim_num > 0) {
+        for (uint32_t p = node.offset; p < node.offset + node.prim_num; ++p) {
+            bounds.merge(box_of(_order[p]));
+        }
+    } else {
+        for (const LinearBVHNode *child : {&_nodes[index + 1], &_nodes[node.offset]}) {
+            bounds.merge(BBox{child->min[0], child->min[1], child->min[2],
+                              child->max[0], child->max[1], child->max[2]});
+        }
+    }
+
+    bool changed = false;
+    for (int axis = 0; axis < 3; ++axis) {
+        changed = changed || node.min[axis] != bounds.min()[axis] || node.max[axis] != bounds.max()[axis];
+        node.min[axis] = bounds.min()[axis];
+        node.max[axis] = bounds.max()[axis];
+    }
+    return changed;
+}
+
+void LinearBVH::refit(const std::function<BBox(uint32_t)> &box_of, const std::vector<uint32_t> &changed,
+                      task_pool *pool, std::vector<uint32_t> &updated) {
+    if (!refittable()) {
+        throw RenderException("A BVH with spatial splits cannot be refitted");
+    }
+    updated.clear();
+    if (_nodes.empty() || changed.empty()) {
+        return;
+    }
+
+    if (pool && changed.size() > BVH_PARALLEL_THRESHOLD) {
+        // children always follow their parent, so one forward sweep gives every depth
+        std::vector<uint32_t> depth(_nodes.size(), 0);
+        uint32_t max_depth = 0;
+        for (uint32_t i = 1; i < _nodes.size(); ++i) {
+            depth[i] = depth[_parents[i]] + 1;
+            max_depth = std::max(depth[i], max_depth);
+        }
+        // bucket the nodes by depth, then refit level by level from the deepest one up
+        std::vector<size_t> level_begin(max_depth + 2, 0);
+        for (uint32_t d : depth) {
+            level_begin[d + 1]++;
+        }
+        for (uint32_t d = 0; d <= max_depth; ++d) {
+            level_begin[d + 1] += level_begin[d];
+        }
+        updated.resize(_nodes.size());
+        std::vector<size_t> fill(level_begin.begin(), level_begin.end() - 1);
+        for (uint32_t i = 0; i < _nodes.size(); ++i) {
+            updated[fill[depth[i]]++] = i;
+        }
+        for (uint32_t d = max_depth + 1; d-- > 0;) {
+            pool->parallel_for(level_begin[d], level_begin[d + 1], BVH_PARALLEL_THRESHOLD / 4,
+                               [&](size_t begin, size_t end) {
+                                   for (size_t k = begin; k < end; ++k) {
+                                       refit_node(updated[k], box_of);
+                                   }
+                               });
+        }
+        _area_sum = 0;
+        for (const LinearBVHNode &node : _nodes) {
+            _area_sum += weighted_area(node);
+        }
+        return;
+    }
+
+    // walk up from every changed leaf, a node whose bounds stay the same leaves its ancestors untouched
+    for (uint32_t prim : changed) {
+        uint32_t index = _leaf_of[prim];
+        while (true) {
+            double old_area = weighted_area(_nodes[index]);
+            if (!refit_node(index, box_of)) {
+                break;
+            }
+            _area_sum += weighted_area(_nodes[index]) - old_area;
+            updated.push_back(index);
+            if (index == 0) {
+                break;
+            }
+            index = _parents[index];
+        }
+    }
+}
+
+void LinearBVH::clear() {
+    _nodes.clear();
+    _order.clear();
+    _parents.clear();
+    _leaf_of.clear();
+    _area_sum = 0;
+    _build_cost = 0;
+}
+
+}
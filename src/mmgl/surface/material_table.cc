@@ -0,0 +1,63 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include <functional>
+
+#include "mmgl/surface/material_table.h"
+
+namespace mmgl {
+
+size_t MaterialHash::operator()(const Material &material) const {
+    // std::hash<float> gives 0 and -0 the same hash, as they compare equal
+    std::hash<float> hash;
+    size_t seed = hash(material.r());
+    for (const Vector *v : {&material.kd(), &material.ks(), &material.ki()}) {
+        seed = seed * 31 + hash(v->x());
+        seed = seed * 31 + hash(v->y());
+        seed = seed * 31 + hash(v->z());
+    }
+    return seed;
+}
+
+uint32_t MaterialTable::add(const Material &material) {
+    auto iter = _ids.find(material);
+    if (iter != _ids.end()) {
+        if (iter->second != 0) {
+            ++_refs[iter->second];
+        }
+        return iter->second;
+    }
+
+    uint32_t id;
+    if (_free.empty()) {
+        id = static_cast<uint32_t>(_materials.size());
+        _materials.push_back(material);
+        _refs.push_back(1);
+    } else {
+        // a surface recolored in every frame gets its previous entry back
+        id = _free.back();
+        _free.pop_back();
+        _materials[id] = material;
+        _refs[id] = 1;
+    }
+    if (material == material) {
+        // a material with a NaN parameter is never equal to another one, it keeps an entry of its own
+        _ids.emplace(material, id);
+    }
+    return id;
+}
+
+void MaterialTable::release(uint32_t id) {
+    if (id == 0 || --_refs[id] > 0) {
+        return;
+    }
+    auto iter = _ids.find(_materials[id]);
+    if (iter != _ids.end() && iter->second == id) {
+        _ids.erase(iter);
+    }
+    _free.push_back(id);
+}
+
+}
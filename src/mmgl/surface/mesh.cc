@@ -0,0 +1,84 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/mesh.h"
+
+namespace mmgl {
+
+namespace {
+
+TriangleMesh soa_mesh(const std::vector<float> &verts, const std::vector<int> &tris) {
+    std::vector<float> xs, ys, zs;
+    xs.reserve(verts.size() / 3);
+    ys.reserve(verts.size() / 3);
+    zs.reserve(verts.size() / 3);
+    for (size_t i = 0; i + 2 < verts.size(); i += 3) {
+        xs.push_back(verts[i]);
+        ys.push_back(verts[i + 1]);
+        zs.push_back(verts[i + 2]);
+    }
+    std::vector<uint32_t> indices;
+    indices.reserve(tris.size());
+    for (int v : tris) {
+        if (v < 0) {
+            throw RenderException("A mesh cannot have negative vertex indices");
+        }
+        indices.push_back(static_cast<uint32_t>(v));
+    }
+    return TriangleMesh{std::move(xs), std::move(ys), std::move(zs), std::move(indices)};
+}
+
+}
+
+Mesh::Mesh(const std::vector<float> &verts, const std::vector<int> &tris, unsigned leaf_size)
+        : _triangles{soa_mesh(verts, tris)}, _bvh{} {
+    init(leaf_size);
+}
+
+Mesh::Mesh(TriangleMesh &&triangles, unsigned leaf_size) : _triangles{std::move(triangles)}, _bvh{} {
+    init(leaf_size);
+}
+
+void Mesh::init(unsigned leaf_size) {
+    // the mesh is built once and shared, so it is worth the best tree
+    std::vector<BBox> boxes;
+    boxes.reserve(_triangles.prim_num());
+    for (uint32_t i = 0; i < _triangles.prim_num(); ++i) {
+        boxes.push_back(_triangles.prim_box(i));
+    }
+    _bvh.build(boxes, BVH::SAH, leaf_size);
+
+    // store the triangles in leaf order, a leaf then covers a contiguous run of them
+    _triangles.reorder(_bvh.order());
+    _bvh.renumber();
+}
+
+template<Render R>
+bool Mesh::intersect(Ray &ray) const {
+    // the leaves cover contiguous runs of triangles, which the batch kernel loads without gathering
+    bool hit = false;
+    _bvh.intersect_leaves(ray, [&](const uint32_t *leaf, uint32_t count) {
+        hit = _triangles.intersect_batch<R>(ray, leaf, count) || hit;
+    });
+    return hit;
+}
+
+template<Render R>
+bool Mesh::occluded(const Ray &ray, float t_max) const {
+    return _bvh.occluded(ray, t_max, [&](const uint32_t *leaf, uint32_t count) {
+        return _triangles.occluded_batch<R>(ray, leaf, count, t_max);
+    });
+}
+
+template bool Mesh::intersect<Render::NORMAL>(Ray &) const;
+template bool Mesh::intersect<Render::BBOX_ONLY>(Ray &) const;
+template bool Mesh::intersect<Render::BVH_BBOX_ONLY>(Ray &) const;
+template bool Mesh::intersect<Render::BVH>(Ray &) const;
+template bool Mesh::occluded<Render::NORMAL>(const Ray &, float) const;
+template bool Mesh::occluded<Render::BBOX_ONLY>(const Ray &, float) const;
+template bool Mesh::occluded<Render::BVH_BBOX_ONLY>(const Ray &, float) const;
+template bool Mesh::occluded<Render::BVH>(const Ray &, float) const;
+
+}
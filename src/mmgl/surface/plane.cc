@@ -0,0 +1,106 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include <limits>
+
+#include "mmgl/surface/plane.h"
+
+namespace mmgl {
+
+Plane::Plane(float nx, float ny, float nz, float d) : _norm{nx, ny, nz}, _d{d} {
+    init();
+}
+
+Plane::Plane(const Vector &normal, float d) : _norm{normal}, _d{d} {
+    init();
+}
+
+void Plane::init() {
+    if (_norm.magnitude() == 0) {
+        throw RenderException("The normal of a plane must not be zero");
+    }
+    _norm.normalize();
+
+    const float n[3] = {_norm._x, _norm._y, _norm._z};
+    float lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (n[axis] == 1 || n[axis] == -1) {
+            lo[axis] = hi[axis] = _d * n[axis];
+        } else {
+            lo[axis] = -std::numeric_limits<float>::infinity();
+            hi[axis] = std::numeric_limits<float>::infinity();
+        }
+    }
+    box(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+}
+
+bool Plane::intersect(Ray &ray, const Render &) const {
+    if (ray.starts_on(this)) {
+        // a flat surface never blocks a ray leaving it
+        return false;
+    }
+    float t;
+    if (!solve(ray, t)) {
+        return false;
+    }
+    if (ray.updatable(t)) {
+        ray.hit(Hit{t, this, 0, 0, 0});
+    }
+    return true;
+}
+
+bool Plane::occluded(const Ray &ray, const Render &, uint32_t, float t_max) const {
+    if (ray.starts_on(this)) {
+        return false;
+    }
+    float t;
+    return solve(ray, t) && t > EPS && t < t_max;
+}
+
+bool Plane::solve(const Ray &ray, float &t) const {
+    float denom = _norm.dot(ray._dir);
+    if (denom == 0) {
+        return false;
+    }
+    t = (_d - _norm._x * ray._origin._x - _norm._y * ray._origin._y - _norm._z * ray._origin._z) / denom;
+    return t >= 0.00005f;
+}
+
+Vector Plane::normal(const Hit &, const Point &) const {
+    return _norm;
+}
+
+std::string Plane::to_string() const {
+    std::stringstream os;
+    os << "Plane:\n";
+    os << "\tnormal: " << _norm << "\n";
+    os << "\td: " << _d << std::flush;
+    return os.str();
+}
+
+Plane &Plane::normal(float nx, float ny, float nz) {
+    _norm._x = nx;
+    _norm._y = ny;
+    _norm._z = nz;
+    init();
+    return *this;
+}
+
+Plane &Plane::normal(const Vector &normal) {
+    return Plane::normal(normal._x, normal._y, normal._z);
+}
+
+Plane &Plane::distance(float d) {
+    _d = d;
+    init();
+    return *this;
+}
+
+Plane &Plane::made_of(const Material &material) {
+    Surface::material(material);
+    return *this;
+}
+
+}
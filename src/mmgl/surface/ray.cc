@@ -8,11 +8,13 @@
 namespace mmgl {
 
 Ray::Ray(const Point &point, const Vector &vector) : _origin{point}, _dir{vector}, _has_intersect{false},
-                                                     _intersection{} { }
+                                                     _hit{}, _start_id{nullptr}, _start_prim{0},
+                                                     _stats{nullptr} { }
 
 Ray::Ray(float pos_x, float pos_y, float pos_z,
          float dir_x, float dir_y, float dir_z) : _origin{pos_x, pos_y, pos_z}, _dir{dir_x, dir_y, dir_z},
-                                                  _has_intersect{false}, _intersection{} { }
+                                                  _has_intersect{false}, _hit{},
+                                                  _start_id{nullptr}, _start_prim{0}, _stats{nullptr} { }
 
 std::ostream &operator<<(std::ostream &os, const Ray &ray) {
     os << "Ray:\n";
@@ -26,13 +28,13 @@ bool Ray::has_block(float max) const {
     if (!has_intersect()) {
         return false;
     } else {
-        return _intersection.t() < max;
+        return _hit.t < max;
     }
 }
 
 bool Ray::updatable(float t) const {
     if (_has_intersect) {
-        return (t > EPS && t < _intersection.t());
+        return (t > EPS && t < _hit.t);
     } else {
         return t > EPS;
     }
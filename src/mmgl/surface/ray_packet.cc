@@ -0,0 +1,165 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "mmgl/surface/ray_packet.h"
+#include "mmgl/util/simd.h"
+
+namespace mmgl {
+
+/**
+ * Portable kernel, tests the rays one after another like LinearBVH::node_intersect.
+ */
+static unsigned packet_intersect_scalar(const float *bounds, const float (*orig)[PACKET_SIZE],
+                                        const float (*inv_dir)[PACKET_SIZE], const float *t_max) {
+    unsigned mask = 0;
+    for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+        float t_in = -std::numeric_limits<float>::infinity();
+        float t_out = t_max[lane];
+        for (int axis = 0; axis < 3; ++axis) {
+            float t0 = (bounds[axis] - orig[axis][lane]) * inv_dir[axis][lane];
+            float t1 = (bounds[axis + 3] - orig[axis][lane]) * inv_dir[axis][lane];
+            t_in = std::max(t_in, std::min(t0, t1));
+            t_out = std::min(t_out, std::max(t0, t1));
+        }
+        if (t_in <= t_out && t_out >= .0f) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+}
+
+#ifdef MMGL_X86_SIMD
+
+/**
+ * Test the 4 rays starting at lane, the box is broadcast and the rays are loaded from the SoA rows.
+ */
+static inline unsigned sse_packet(const float *bounds, const float (*orig)[PACKET_SIZE],
+                                  const float (*inv_dir)[PACKET_SIZE], const float *t_max, int lane) {
+    __m128 t_in = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    __m128 t_out = _mm_loadu_ps(t_max + lane);
+    for (int axis = 0; axis < 3; ++axis) {
+        __m128 o = _mm_loadu_ps(orig[axis] + lane);
+        __m128 inv = _mm_loadu_ps(inv_dir[axis] + lane);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds[axis]), o), inv);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds[axis + 3]), o), inv);
+        t_in = _mm_max_ps(_mm_min_ps(t0, t1), t_in);
+        t_out = _mm_min_ps(_mm_max_ps(t0, t1), t_out);
+    }
+    __m128 hit = _mm_and_ps(_mm_cmple_ps(t_in, t_out), _mm_cmpge_ps(t_out, _mm_setzero_ps()));
+    return static_cast<unsigned>(_mm_movemask_ps(hit));
+}
+
+static unsigned packet_intersect_sse(const float *bounds, const float (*orig)[PACKET_SIZE],
+                                     const float (*inv_dir)[PACKET_SIZE], const float *t_max) {
+    unsigned mask = 0;
+    for (int lane = 0; lane < PACKET_SIZE; lane += 4) {
+        mask |= sse_packet(bounds, orig, inv_dir, t_max, lane) << lane;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static unsigned packet_intersect_avx(const float *bounds, const float (*orig)[PACKET_SIZE],
+                                     const float (*inv_dir)[PACKET_SIZE], const float *t_max) {
+    unsigned mask = 0;
+    for (int lane = 0; lane < PACKET_SIZE; lane += 8) {
+        __m256 t_in = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+        __m256 t_out = _mm256_loadu_ps(t_max + lane);
+        for (int axis = 0; axis < 3; ++axis) {
+            __m256 o = _mm256_loadu_ps(orig[axis] + lane);
+            __m256 inv = _mm256_loadu_ps(inv_dir[axis] + lane);
+            __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds[axis]), o), inv);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds[axis + 3]), o), inv);
+            t_in = _mm256_max_ps(_mm256_min_ps(t0, t1), t_in);
+            t_out = _mm256_min_ps(_mm256_max_ps(t0, t1), t_out);
+        }
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(t_in, t_out, _CMP_LE_OQ),
+                                   _mm256_cmp_ps(t_out, _mm256_setzero_ps(), _CMP_GE_OQ));
+        mask |= static_cast<unsigned>(_mm256_movemask_ps(hit)) << lane;
+    }
+    return mask;
+}
+
+#endif
+
+/**
+ * The widest kernel the CPU runs.
+ */
+static PacketKernel packet_kernel() {
+#ifdef MMGL_X86_SIMD
+    SimdLevel level = simd_level();
+    if (level == SimdLevel::AVX2) {
+        return &packet_intersect_avx;
+    } else if (level == SimdLevel::SSE) {
+        return &packet_intersect_sse;
+    }
+#endif
+    return &packet_intersect_scalar;
+}
+
+void RayPacket::add(const Ray &ray) {
+    unsigned lane = _num++;
+    _rays[lane] = ray;
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float dir[3] = {ray.dir().x(), ray.dir().y(), ray.dir().z()};
+    for (int axis = 0; axis < 3; ++axis) {
+        _orig[axis][lane] = orig[axis];
+        _inv_dir[axis][lane] = 1.0f / dir[axis];
+    }
+    _t_max[lane] = ray.has_intersect() ? ray.hit().t : std::numeric_limits<float>::infinity();
+}
+
+void RayPacket::finish() {
+    // unused lanes repeat the first ray, so they never widen the bounds
+    for (unsigned lane = _num; lane < PACKET_SIZE; ++lane) {
+        for (int axis = 0; axis < 3; ++axis) {
+            _orig[axis][lane] = _orig[axis][0];
+            _inv_dir[axis][lane] = _inv_dir[axis][0];
+        }
+        _t_max[lane] = _t_max[0];
+    }
+
+    _coherent = _num > 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        _orig_lo[axis] = *std::min_element(_orig[axis], _orig[axis] + PACKET_SIZE);
+        _orig_hi[axis] = *std::max_element(_orig[axis], _orig[axis] + PACKET_SIZE);
+        _inv_lo[axis] = *std::min_element(_inv_dir[axis], _inv_dir[axis] + PACKET_SIZE);
+        _inv_hi[axis] = *std::max_element(_inv_dir[axis], _inv_dir[axis] + PACKET_SIZE);
+        // a zero direction component gives an infinite inverse, whose interval products may be NaN
+        _coherent = _coherent && std::isfinite(_inv_lo[axis]) && std::isfinite(_inv_hi[axis]) &&
+                    (_inv_lo[axis] > 0 || _inv_hi[axis] < 0);
+    }
+}
+
+bool RayPacket::misses(const float *min, const float *max) const {
+    // every ray enters the box after t_in and leaves it before t_out
+    float t_in = -std::numeric_limits<float>::infinity();
+    float t_out = std::numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; ++axis) {
+        bool neg = _inv_hi[axis] < 0;
+        float near = neg ? max[axis] : min[axis];
+        float far = neg ? min[axis] : max[axis];
+        // interval products of (plane - origin) and the inverse direction
+        float n0 = (near - _orig_hi[axis]) * _inv_lo[axis], n1 = (near - _orig_hi[axis]) * _inv_hi[axis];
+        float n2 = (near - _orig_lo[axis]) * _inv_lo[axis], n3 = (near - _orig_lo[axis]) * _inv_hi[axis];
+        float f0 = (far - _orig_hi[axis]) * _inv_lo[axis], f1 = (far - _orig_hi[axis]) * _inv_hi[axis];
+        float f2 = (far - _orig_lo[axis]) * _inv_lo[axis], f3 = (far - _orig_lo[axis]) * _inv_hi[axis];
+        t_in = std::max(t_in, std::min(std::min(n0, n1), std::min(n2, n3)));
+        t_out = std::min(t_out, std::max(std::max(f0, f1), std::max(f2, f3)));
+    }
+    float t_max = *std::max_element(_t_max, _t_max + PACKET_SIZE);
+    return t_in > t_out || t_out < .0f || t_in > t_max;
+}
+
+unsigned RayPacket::intersect(const float *min, const float *max, unsigned active) const {
+    static const PacketKernel kernel = packet_kernel();
+    const float bounds[6] = {min[0], min[1], min[2], max[0], max[1], max[2]};
+    return kernel(bounds, _orig, _inv_dir, _t_max) & active;
+}
+
+}
@@ -0,0 +1,443 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/linear_bvh.h"
+#include "mmgl/util/thread_pool.h"
+
+#define SBVH_OVERLAP_ALPHA 1e-5f
+
+namespace mmgl {
+
+namespace {
+
+/**
+ * Reference to a primitive or to the part of it inside box.
+ */
+struct Reference {
+    BBox box;
+    uint32_t index;
+};
+
+struct ObjectSplit {
+    float cost = std::numeric_limits<float>::infinity();
+    int axis = 0;
+    int split = 0;
+    float low = .0f;
+    float scale = .0f;
+    BBox left = BBox::empty();
+    BBox right = BBox::empty();
+};
+
+struct SpatialSplit {
+    float cost = std::numeric_limits<float>::infinity();
+    int axis = 0;
+    float position = .0f;
+    size_t duplicates = 0;
+};
+
+/**
+ * Copy of box with the bounds along axis replaced.
+ */
+inline BBox slab(const BBox &box, int axis, float low, float high) {
+    float lo[3] = {box.min().x(), box.min().y(), box.min().z()};
+    float hi[3] = {box.max().x(), box.max().y(), box.max().z()};
+    lo[axis] = low;
+    hi[axis] = high;
+    return BBox{lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]};
+}
+
+inline int centroid_bin(float center, float low, float scale) {
+    return std::min(static_cast<int>((center - low) * scale), SAH_BIN_NUM - 1);
+}
+
+/**
+ * Spatial split BVH builder after Stich et al. 2009. Every node compares the best binned object split
+ * with the best spatial split, the latter only when the children of the object split overlap noticeably.
+ * Each node gets a budget of extra references, shared by its children in proportion to their size,
+ * so subtrees built in parallel come out the same as in a serial build.
+ */
+class SBVHBuilder {
+public:
+    SBVHBuilder(const BoxClipper &clip, float root_area, unsigned leaf_size, task_pool *pool)
+            : _clip(clip), _root_area{root_area}, _leaf_size{leaf_size}, _pool{pool} { }
+
+    /**
+     * Build the subtree over refs into nodes, appending its leaf primitives to order.
+     * Return the index of its root node.
+     */
+    uint32_t build(std::vector<Reference> &refs, size_t budget, int depth,
+                   std::vector<LinearBVHNode> &nodes, std::vector<uint32_t> &order);
+
+private:
+    ObjectSplit find_object_split(const std::vector<Reference> &refs) const;
+
+    SpatialSplit find_spatial_split(const std::vector<Reference> &refs, const BBox &bounds) const;
+
+    void object_partition(std::vector<Reference> &refs, const ObjectSplit &split,
+                          std::vector<Reference> &left, std::vector<Reference> &right) const;
+
+    void spatial_partition(std::vector<Reference> &refs, const SpatialSplit &split,
+                           std::vector<Reference> &left, std::vector<Reference> &right) const;
+
+    /**
+     * Median split along the longest centroid axis, the fallback that always makes progress.
+     */
+    void median_partition(std::vector<Reference> &refs, int &axis,
+                          std::vector<Reference> &left, std::vector<Reference> &right) const;
+
+    /**
+     * Clip a reference into the parts on both sides of a plane.
+     */
+    void split_reference(const Reference &ref, int axis, float position, Reference &left, Reference &right) const;
+
+    const BoxClipper &_clip;
+    float _root_area;
+    size_t _leaf_size;
+    task_pool *_pool;
+};
+
+uint32_t SBVHBuilder::build(std::vector<Reference> &refs, size_t budget, int depth,
+                            std::vector<LinearBVHNode> &nodes, std::vector<uint32_t> &order) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    BBox bounds = BBox::empty();
+    for (const Reference &ref : refs) {
+        bounds.merge(ref.box);
+    }
+
+    LinearBVHNode node{};
+    for (int axis = 0; axis < 3; ++axis) {
+        node.min[axis] = bounds.min()[axis];
+        node.max[axis] = bounds.max()[axis];
+    }
+
+    // the references of a primitive always end up in different subtrees, so a leaf never repeats one
+    bool leaf = refs.size() == 1 || (refs.size() <= _leaf_size && depth >= BVH_MAX_CUT_DEPTH);
+    std::vector<Reference> left, right;
+    int axis = 0;
+    if (!leaf && depth >= BVH_MAX_CUT_DEPTH) {
+        // bound the depth, so the traversal stack never overflows
+        median_partition(refs, axis, left, right);
+    } else if (!leaf) {
+        ObjectSplit object = find_object_split(refs);
+        SpatialSplit spatial;
+        // spatial splits only pay off where the children of the object split overlap
+        BBox overlap = object.left.overlap(object.right);
+        if (budget > 0 && overlap.valid() && overlap.area() > SBVH_OVERLAP_ALPHA * _root_area) {
+            spatial = find_spatial_split(refs, bounds);
+        }
+        // small nodes stay leaves where testing all their references is cheaper than any split
+        float split_cost = std::min(object.cost, spatial.duplicates <= budget ? spatial.cost : object.cost);
+        leaf = refs.size() <= _leaf_size &&
+               refs.size() * bounds.area() <= SAH_TRAVERSAL_COST * bounds.area() + split_cost;
+        if (!leaf) {
+            if (spatial.cost < object.cost && spatial.duplicates <= budget) {
+                axis = spatial.axis;
+                spatial_partition(refs, spatial, left, right);
+            } else if (object.cost < std::numeric_limits<float>::infinity()) {
+                axis = object.axis;
+                object_partition(refs, object, left, right);
+            }
+            if (left.empty() || right.empty()) {
+                // nothing was separated, fall back to a count cut of the untouched references
+                left.clear();
+                right.clear();
+                median_partition(refs, axis, left, right);
+            }
+        }
+    }
+    if (leaf) {
+        node.offset = static_cast<uint32_t>(order.size());
+        node.prim_num = static_cast<uint16_t>(refs.size());
+        for (const Reference &ref : refs) {
+            order.push_back(ref.index);
+        }
+        nodes[index] = node;
+        return index;
+    }
+
+    size_t parent_num = refs.size();
+    std::vector<Reference>().swap(refs);
+
+    // the remaining budget goes to the children in proportion to their size
+    size_t child_num = left.size() + right.size();
+    size_t duplicates = child_num > parent_num ? child_num - parent_num : 0;
+    size_t remaining = budget > duplicates ? budget - duplicates : 0;
+    size_t left_budget = remaining * left.size() / (left.size() + right.size());
+    size_t right_budget = remaining - left_budget;
+
+    if (_pool && left.size() + right.size() >= BVH_PARALLEL_THRESHOLD) {
+        // left subtree as a task, right one here, then splice both behind this node
+        std::vector<LinearBVHNode> left_nodes, right_nodes;
+        std::vector<uint32_t> left_order, right_order;
+        auto task = _pool->submit([&]() { build(left, left_budget, depth + 1, left_nodes, left_order); });
+        build(right, right_budget, depth + 1, right_nodes, right_order);
+        _pool->wait(task);
+        task.get();
+
+        for (int side = 0; side < 2; ++side) {
+            std::vector<LinearBVHNode> &sub_nodes = side == 0 ? left_nodes : right_nodes;
+            std::vector<uint32_t> &sub_order = side == 0 ? left_order : right_order;
+            uint32_t node_base = static_cast<uint32_t>(nodes.size());
+            uint32_t order_base = static_cast<uint32_t>(order.size());
+            for (LinearBVHNode &sub_node : sub_nodes) {
+                sub_node.offset += sub_node.prim_num == 0 ? node_base : order_base;
+                nodes.push_back(sub_node);
+            }
+            order.insert(order.end(), sub_order.begin(), sub_order.end());
+        }
+        node.offset = index + 1 + static_cast<uint32_t>(left_nodes.size());
+    } else {
+        build(left, left_budget, depth + 1, nodes, order);
+        node.offset = build(right, right_budget, depth + 1, nodes, order);
+    }
+    node.axis = static_cast<uint8_t>(axis);
+    nodes[index] = node;
+    return index;
+}
+
+ObjectSplit SBVHBuilder::find_object_split(const std::vector<Reference> &refs) const {
+    BBox centroids = BBox::empty();
+    for (const Reference &ref : refs) {
+        centroids.merge(BBox{ref.box.center(0), ref.box.center(1), ref.box.center(2),
+                             ref.box.center(0), ref.box.center(1), ref.box.center(2)});
+    }
+
+    ObjectSplit best;
+    for (int k = 0; k < 3; ++k) {
+        float low = centroids.min()[k];
+        float extent = centroids.max()[k] - low;
+        if (extent <= .0f) {
+            continue;
+        }
+        float scale = SAH_BIN_NUM / extent;
+
+        size_t counts[SAH_BIN_NUM] = {};
+        BBox boxes[SAH_BIN_NUM];
+        std::fill(boxes, boxes + SAH_BIN_NUM, BBox::empty());
+        for (const Reference &ref : refs) {
+            int bin = centroid_bin(ref.box.center(k), low, scale);
+            counts[bin]++;
+            boxes[bin].merge(ref.box);
+        }
+
+        // sweep from the right to get every right side, then from the left to get the cost
+        BBox right_boxes[SAH_BIN_NUM];
+        size_t right_counts[SAH_BIN_NUM];
+        size_t count = 0;
+        BBox acc = BBox::empty();
+        for (int b = SAH_BIN_NUM - 1; b > 0; --b) {
+            count += counts[b];
+            acc.merge(boxes[b]);
+            right_boxes[b] = acc;
+            right_counts[b] = count;
+        }
+        count = 0;
+        acc = BBox::empty();
+        for (int b = 0; b < SAH_BIN_NUM - 1; ++b) {
+            count += counts[b];
+            acc.merge(boxes[b]);
+            if (count == 0 || right_counts[b + 1] == 0) {
+                continue;
+            }
+            float cost = acc.area() * count + right_boxes[b + 1].area() * right_counts[b + 1];
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.axis = k;
+                best.split = b + 1;
+                best.low = low;
+                best.scale = scale;
+                best.left = acc;
+                best.right = right_boxes[b + 1];
+            }
+        }
+    }
+    return best;
+}
+
+SpatialSplit SBVHBuilder::find_spatial_split(const std::vector<Reference> &refs, const BBox &bounds) const {
+    SpatialSplit best;
+    for (int k = 0; k < 3; ++k) {
+        float low = bounds.min()[k];
+        float extent = bounds.max()[k] - low;
+        if (extent <= .0f) {
+            continue;
+        }
+        float bin_size = extent / SBVH_BIN_NUM;
+        auto bin_of = [=](float value) {
+            return std::min(std::max(static_cast<int>((value - low) / bin_size), 0), SBVH_BIN_NUM - 1);
+        };
+
+        // every reference enters one bin and leaves another one, the bins in between get its clipped parts
+        size_t entries[SBVH_BIN_NUM] = {};
+        size_t exits[SBVH_BIN_NUM] = {};
+        BBox boxes[SBVH_BIN_NUM];
+        std::fill(boxes, boxes + SBVH_BIN_NUM, BBox::empty());
+        for (const Reference &ref : refs) {
+            int first = bin_of(ref.box.min()[k]);
+            int last = bin_of(ref.box.max()[k]);
+            Reference rest = ref;
+            for (int b = first; b < last; ++b) {
+                Reference left, right;
+                split_reference(rest, k, low + bin_size * (b + 1), left, right);
+                boxes[b].merge(left.box);
+                rest = right;
+            }
+            boxes[last].merge(rest.box);
+            entries[first]++;
+            exits[last]++;
+        }
+
+        BBox right_boxes[SBVH_BIN_NUM];
+        size_t right_counts[SBVH_BIN_NUM];
+        size_t count = 0;
+        BBox acc = BBox::empty();
+        for (int b = SBVH_BIN_NUM - 1; b > 0; --b) {
+            count += exits[b];
+            acc.merge(boxes[b]);
+            right_boxes[b] = acc;
+            right_counts[b] = count;
+        }
+        count = 0;
+        acc = BBox::empty();
+        for (int b = 0; b < SBVH_BIN_NUM - 1; ++b) {
+            count += entries[b];
+            acc.merge(boxes[b]);
+            if (count == 0 || right_counts[b + 1] == 0) {
+                continue;
+            }
+            float cost = acc.area() * count + right_boxes[b + 1].area() * right_counts[b + 1];
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.axis = k;
+                best.position = low + bin_size * (b + 1);
+                best.duplicates = count + right_counts[b + 1] - refs.size();
+            }
+        }
+    }
+    return best;
+}
+
+void SBVHBuilder::object_partition(std::vector<Reference> &refs, const ObjectSplit &split,
+                                   std::vector<Reference> &left, std::vector<Reference> &right) const {
+    for (const Reference &ref : refs) {
+        if (centroid_bin(ref.box.center(split.axis), split.low, split.scale) < split.split) {
+            left.push_back(ref);
+        } else {
+            right.push_back(ref);
+        }
+    }
+}
+
+void SBVHBuilder::spatial_partition(std::vector<Reference> &refs, const SpatialSplit &split,
+                                    std::vector<Reference> &left, std::vector<Reference> &right) const {
+    const int k = split.axis;
+    BBox left_bounds = BBox::empty(), right_bounds = BBox::empty();
+    std::vector<Reference> straddling;
+    for (const Reference &ref : refs) {
+        if (ref.box.max()[k] <= split.position) {
+            left.push_back(ref);
+            left_bounds.merge(ref.box);
+        } else if (ref.box.min()[k] >= split.position) {
+            right.push_back(ref);
+            right_bounds.merge(ref.box);
+        } else {
+            straddling.push_back(ref);
+        }
+    }
+
+    // reference unsplitting: a straddling reference goes to one side only where that is cheaper
+    size_t left_num = left.size() + straddling.size();
+    size_t right_num = right.size() + straddling.size();
+    for (const Reference &ref : straddling) {
+        Reference left_part, right_part;
+        split_reference(ref, k, split.position, left_part, right_part);
+        BBox split_left = left_bounds, split_right = right_bounds;
+        split_left.merge(left_part.box);
+        split_right.merge(right_part.box);
+        BBox whole_left = left_bounds, whole_right = right_bounds;
+        whole_left.merge(ref.box);
+        whole_right.merge(ref.box);
+
+        float split_cost = split_left.area() * left_num + split_right.area() * right_num;
+        float left_cost = whole_left.area() * left_num + right_bounds.area() * (right_num - 1);
+        float right_cost = left_bounds.area() * (left_num - 1) + whole_right.area() * right_num;
+        if (right_bounds.valid() && left_cost < split_cost && left_cost <= right_cost) {
+            left.push_back(ref);
+            left_bounds = whole_left;
+            right_num--;
+        } else if (left_bounds.valid() && right_cost < split_cost) {
+            right.push_back(ref);
+            right_bounds = whole_right;
+            left_num--;
+        } else if (left_part.box.valid() || right_part.box.valid()) {
+            if (left_part.box.valid()) {
+                left.push_back(left_part);
+                left_bounds = split_left;
+            }
+            if (right_part.box.valid()) {
+                right.push_back(right_part);
+                right_bounds = split_right;
+            }
+        } else {
+            // the clipper found nothing on either side, never drop the primitive
+            left.push_back(ref);
+            left_bounds = whole_left;
+        }
+    }
+}
+
+void SBVHBuilder::median_partition(std::vector<Reference> &refs, int &axis,
+                                   std::vector<Reference> &left, std::vector<Reference> &right) const {
+    BBox centroids = BBox::empty();
+    for (const Reference &ref : refs) {
+        centroids.merge(BBox{ref.box.center(0), ref.box.center(1), ref.box.center(2),
+                             ref.box.center(0), ref.box.center(1), ref.box.center(2)});
+    }
+    axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if (centroids.max()[k] - centroids.min()[k] > centroids.max()[axis] - centroids.min()[axis]) {
+            axis = k;
+        }
+    }
+    const int k = axis;
+    auto median = refs.begin() + refs.size() / 2;
+    std::nth_element(refs.begin(), median, refs.end(), [k](const Reference &l, const Reference &r) {
+        float lv = l.box.center(k), rv = r.box.center(k);
+        return lv < rv || (lv == rv && l.index < r.index);
+    });
+    left.assign(refs.begin(), median);
+    right.assign(median, refs.end());
+}
+
+void SBVHBuilder::split_reference(const Reference &ref, int axis, float position,
+                                  Reference &left, Reference &right) const {
+    BBox left_half = slab(ref.box, axis, ref.box.min()[axis], position);
+    BBox right_half = slab(ref.box, axis, position, ref.box.max()[axis]);
+    left = Reference{_clip(ref.index, left_half).overlap(left_half), ref.index};
+    right = Reference{_clip(ref.index, right_half).overlap(right_half), ref.index};
+}
+
+}
+
+void LinearBVH::build_sbvh(const std::vector<BBox> &boxes, unsigned leaf_size, const BoxClipper &clip,
+                           task_pool *pool) {
+    std::vector<Reference> refs;
+    refs.reserve(boxes.size());
+    BBox bounds = BBox::empty();
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        refs.push_back(Reference{boxes[i], static_cast<uint32_t>(i)});
+        bounds.merge(boxes[i]);
+    }
+
+    size_t budget = static_cast<size_t>(boxes.size() * SBVH_MAX_DUPLICATION);
+    _nodes.reserve(2 * (boxes.size() + budget));
+    _order.reserve(boxes.size() + budget);
+    SBVHBuilder builder{clip, bounds.area(), leaf_size, pool};
+    builder.build(refs, budget, 0, _nodes, _order);
+}
+
+}
@@ -16,51 +16,101 @@ Sphere::Sphere(const Point &origin, float radius) : _origin{origin}, _radius{rad
 }
 
 bool Sphere::intersect(Ray &ray, const Render &flag) const {
+    return box_only(flag) ? intersect<Render::BBOX_ONLY>(ray) : intersect<Render::NORMAL>(ray);
+}
+
+template<Render R>
+bool Sphere::intersect(Ray &ray) const {
+    if (ray.starts_on(this)) {
+        // a shadow or reflection ray never hits the surface it leaves
+        return false;
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->sphere_tests++;
+    }
     std::pair<bool, float> box_hit = box_intersect(ray);
     if (!box_hit.first) {
         return false;
     }
-    if (flag == Render::BVH_BBOX_ONLY || flag == Render::BBOX_ONLY) {
+    if (box_only<R>()) {
         if (ray.updatable(box_hit.second)) {
-            Point inter_p = ray._origin + ray._dir * box_hit.second;
-            Vector norm = box_normal(inter_p);
-            ray.intersection(Intersection(box_hit.second, inter_p, norm, this));
+            ray.hit(Hit{box_hit.second, this, 0, 0, 0});
         }
         return true;
     }
 
-    if (ray.has_intersect() && ray.intersection().t() < box_hit.second) {
+    if (ray.has_intersect() && ray.hit().t < box_hit.second) {
         // skip intersection computation if bbox distance is larger than closest intersection point
         return true;
     }
 
+    float t;
+    if (!solve(ray, t)) {
+        return false;
+    }
+    if (ray.updatable(t)) {
+        ray.hit(Hit{t, this, 0, 0, 0});
+    }
+    return true;
+}
+
+Vector Sphere::normal(const Hit &, const Point &point) const {
+    Vector norm = point - _origin;
+    norm.normalize();
+    return norm;
+}
+
+bool Sphere::occluded(const Ray &ray, const Render &flag, uint32_t, float t_max) const {
+    return box_only(flag) ? occluded<Render::BBOX_ONLY>(ray, t_max) : occluded<Render::NORMAL>(ray, t_max);
+}
+
+template<Render R>
+bool Sphere::occluded(const Ray &ray, float t_max) const {
+    if (ray.starts_on(this)) {
+        return false;
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->sphere_tests++;
+    }
+    std::pair<bool, float> box_hit = box_intersect(ray);
+    if (!box_hit.first) {
+        return false;
+    }
+    if (box_only<R>()) {
+        // blocked where intersect<R> would record the box hit
+        return box_hit.second > EPS && box_hit.second < t_max;
+    }
+    float t;
+    return solve(ray, t) && t > EPS && t < t_max;
+}
+
+template bool Sphere::intersect<Render::NORMAL>(Ray &) const;
+template bool Sphere::intersect<Render::BBOX_ONLY>(Ray &) const;
+template bool Sphere::intersect<Render::BVH_BBOX_ONLY>(Ray &) const;
+template bool Sphere::intersect<Render::BVH>(Ray &) const;
+template bool Sphere::occluded<Render::NORMAL>(const Ray &, float) const;
+template bool Sphere::occluded<Render::BBOX_ONLY>(const Ray &, float) const;
+template bool Sphere::occluded<Render::BVH_BBOX_ONLY>(const Ray &, float) const;
+template bool Sphere::occluded<Render::BVH>(const Ray &, float) const;
+
+bool Sphere::solve(const Ray &ray, float &t) const {
     Vector oo = ray._origin - _origin;
     Vector r_dir = ray._dir;
     float r_oo = r_dir.dot(oo);
     float r_r = r_dir.dot(r_dir);
     float discriminant = r_oo * r_oo - r_r * (oo.dot(oo) - _radius * _radius);
-    if (discriminant >= 0) {
-        // get the parameterization of the intersection point
-        float t;
-        if (discriminant == 0) {
-            t = -r_oo / r_r;
-        } else {
-            float t1 = (-r_oo + sqrtf(discriminant)) / r_r;
-            float t2 = (-r_oo - sqrtf(discriminant)) / r_r;
-            t = (t1 < t2 ? t1 : t2);
-        }
-        if (t < 0)
-            return false;
-        if (ray.updatable(t)) {
-            Point inter_p = ray._origin + ray._dir * t;
-            Vector norm = inter_p - _origin;
-            norm.normalize();
-            ray.intersection(Intersection(t, inter_p, norm, this));
-        }
-        return true;
-    } else {
+    if (discriminant < 0) {
         return false;
     }
+    // get the parameterization of the intersection point
+    if (discriminant == 0) {
+        t = -r_oo / r_r;
+    } else {
+        float t1 = (-r_oo + sqrtf(discriminant)) / r_r;
+        float t2 = (-r_oo - sqrtf(discriminant)) / r_r;
+        t = (t1 < t2 ? t1 : t2);
+    }
+    return t >= 0;
 }
 
 std::string Sphere::to_string() const {
@@ -7,6 +7,59 @@
 
 namespace mmgl {
 
+Surface::Surface(const Surface &other)
+        : _materials{other._materials}, _material{other._material}, _slot{other._slot}, _box{other._box},
+          _listener{other._listener} {
+    _materials->acquire(_material);
+}
+
+Surface &Surface::operator=(const Surface &other) {
+    other._materials->acquire(other._material);
+    _materials->release(_material);
+    _materials = other._materials;
+    _material = other._material;
+    _slot = other._slot;
+    _box = other._box;
+    _listener = other._listener;
+    return *this;
+}
+
+Surface::~Surface() {
+    _materials->release(_material);
+}
+
+void Surface::material(const Material &material) {
+    // released first, so a material nobody else uses gets the same entry back and references to it stay valid
+    _materials->release(_material);
+    _material = _materials->add(material);
+}
+
+void Surface::materials(MaterialTable *materials) {
+    _materials->release(_material);
+    _materials = materials ? materials : &standalone_materials();
+    _material = 0;
+}
+
+MaterialTable &Surface::standalone_materials() {
+    static MaterialTable materials;
+    return materials;
+}
+
+bool Surface::occluded(const Ray &ray, const Render &flag, uint32_t prim, float t_max) const {
+    Ray probe{ray.origin(), ray.dir()};
+    probe.start_at(ray.start_id(), ray.start_prim());
+    probe.stats(ray.stats());
+    intersect(probe, flag, prim);
+    return probe.has_block(t_max);
+}
+
+Intersection Surface::intersection(const Ray &ray, const Render &flag) const {
+    const Hit &hit = ray.hit();
+    Point inter_p = ray.origin() + ray.dir() * hit.t;
+    Vector norm = box_only(flag) && bounded() ? prim_box(hit.prim).normal(inter_p) : normal(hit, inter_p);
+    return Intersection{hit.t, inter_p, norm, this, &material(), hit.prim};
+}
+
 std::ostream &operator<<(std::ostream &os, const Surface &surface) {
     os << surface.to_string() << std::flush;
     return os;
@@ -18,24 +18,82 @@ Triangle::Triangle(const Point &p1, const Point &p2, const Point &p3) : _p1{p1},
 }
 
 bool Triangle::intersect(Ray &ray, const Render &flag) const {
+    return box_only(flag) ? intersect<Render::BBOX_ONLY>(ray) : intersect<Render::NORMAL>(ray);
+}
+
+template<Render R>
+bool Triangle::intersect(Ray &ray) const {
+    if (ray.starts_on(this)) {
+        // a shadow or reflection ray never hits the surface it leaves
+        return false;
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->triangle_tests++;
+    }
     std::pair<bool, float> box_hit = box_intersect(ray);
     if (!box_hit.first) {
         return false;
     }
-    if (flag == Render::BVH_BBOX_ONLY || flag == Render::BBOX_ONLY) {
+    if (box_only<R>()) {
         if (ray.updatable(box_hit.second)) {
-            Point inter_p = ray._origin + ray._dir * box_hit.second;
-            Vector norm = box_normal(inter_p);
-            ray.intersection(Intersection(box_hit.second, inter_p, norm, this));
+            ray.hit(Hit{box_hit.second, this, 0, 0, 0});
         }
         return true;
     }
 
-    if (ray.has_intersect() && ray.intersection().t() < box_hit.second) {
+    if (ray.has_intersect() && ray.hit().t < box_hit.second) {
         // skip intersection computation if bbox distance is larger than closest intersection point
         return true;
     }
 
+    float t, beta, gamma;
+    if (!solve(ray, t, beta, gamma)) {
+        return false;
+    }
+    if (ray.updatable(t)) {
+        ray.hit(Hit{t, this, 0, beta, gamma});
+    }
+    return true;
+}
+
+Vector Triangle::normal(const Hit &, const Point &) const {
+    return _norm;
+}
+
+bool Triangle::occluded(const Ray &ray, const Render &flag, uint32_t, float t_max) const {
+    return box_only(flag) ? occluded<Render::BBOX_ONLY>(ray, t_max) : occluded<Render::NORMAL>(ray, t_max);
+}
+
+template<Render R>
+bool Triangle::occluded(const Ray &ray, float t_max) const {
+    if (ray.starts_on(this)) {
+        return false;
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->triangle_tests++;
+    }
+    std::pair<bool, float> box_hit = box_intersect(ray);
+    if (!box_hit.first) {
+        return false;
+    }
+    if (box_only<R>()) {
+        // blocked where intersect<R> would record the box hit
+        return box_hit.second > EPS && box_hit.second < t_max;
+    }
+    float t, beta, gamma;
+    return solve(ray, t, beta, gamma) && t > EPS && t < t_max;
+}
+
+template bool Triangle::intersect<Render::NORMAL>(Ray &) const;
+template bool Triangle::intersect<Render::BBOX_ONLY>(Ray &) const;
+template bool Triangle::intersect<Render::BVH_BBOX_ONLY>(Ray &) const;
+template bool Triangle::intersect<Render::BVH>(Ray &) const;
+template bool Triangle::occluded<Render::NORMAL>(const Ray &, float) const;
+template bool Triangle::occluded<Render::BBOX_ONLY>(const Ray &, float) const;
+template bool Triangle::occluded<Render::BVH_BBOX_ONLY>(const Ray &, float) const;
+template bool Triangle::occluded<Render::BVH>(const Ray &, float) const;
+
+bool Triangle::solve(const Ray &ray, float &t, float &beta, float &gamma) const {
     // method from book: fundamentals of computer graphics
     float g, h, i, j, k, l, ei_hf, gf_di, dh_eg, ak_jb, jc_al, bl_kc;
     g = ray._dir._x;
@@ -50,7 +108,7 @@ bool Triangle::intersect(Ray &ray, const Render &flag) const {
     ak_jb = _a * k - j * _b;
     jc_al = j * _c - _a * l;
     bl_kc = _b * l - k * _c;
-    float beta, gamma, t, M;
+    float M;
     M = _a * ei_hf + _b * gf_di + _c * dh_eg;
     // we need the linear solution can have some conditions for early termination
     t = -(_f * ak_jb + _e * jc_al + _d * bl_kc) / M;
@@ -60,15 +118,62 @@ bool Triangle::intersect(Ray &ray, const Render &flag) const {
     if (gamma < 0 || gamma > 1)
         return false;
     beta = (j * ei_hf + k * gf_di + l * dh_eg) / M;
-    if (beta < 0 || beta > (1 - gamma)) {
-        return false;
+    return !(beta < 0 || beta > (1 - gamma));
+}
+
+BBox Triangle::clip(const BBox &bounds) const {
+    return clip_triangle(_p1, _p2, _p3, bounds);
+}
+
+BBox clip_triangle(const Point &p1, const Point &p2, const Point &p3, const BBox &bounds) {
+    // Sutherland-Hodgman against the six planes of bounds, each plane adds at most one vertex
+    float polygon[9][3] = {{p1.x(), p1.y(), p1.z()}, {p2.x(), p2.y(), p2.z()}, {p3.x(), p3.y(), p3.z()}};
+    float clipped[9][3];
+    int n = 3;
+    for (int plane = 0; plane < 6 && n > 0; ++plane) {
+        int axis = plane % 3;
+        float position = plane < 3 ? bounds.min()[axis] : bounds.max()[axis];
+        float sign = plane < 3 ? 1.0f : -1.0f;
+        int m = 0;
+        for (int i = 0; i < n; ++i) {
+            const float *a = polygon[i];
+            const float *b = polygon[(i + 1) % n];
+            float da = (a[axis] - position) * sign;
+            float db = (b[axis] - position) * sign;
+            if (da >= 0) {
+                std::copy(a, a + 3, clipped[m++]);
+            }
+            if ((da < 0 && db > 0) || (da > 0 && db < 0)) {
+                float t = da / (da - db);
+                for (int k = 0; k < 3; ++k) {
+                    clipped[m][k] = a[k] + (b[k] - a[k]) * t;
+                }
+                clipped[m++][axis] = position;
+            }
+        }
+        std::copy(&clipped[0][0], &clipped[0][0] + 3 * m, &polygon[0][0]);
+        n = m;
     }
-    if (ray.updatable(t)) {
-        // if we survive here, compute the intersection point
-        Point inter_p = ray._origin + ray._dir * t;
-        ray.intersection(Intersection{t, inter_p, _norm, this});
+
+    if (n == 0) {
+        return BBox::empty();
     }
-    return true;
+    float lo[3] = {polygon[0][0], polygon[0][1], polygon[0][2]};
+    float hi[3] = {polygon[0][0], polygon[0][1], polygon[0][2]};
+    for (int i = 1; i < n; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], polygon[i][k]);
+            hi[k] = std::max(hi[k], polygon[i][k]);
+        }
+    }
+    // padded like the box of the whole triangle, so rounding at the cut never opens a crack
+    BBox ret;
+    ret.box(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+    BBox box;
+    box.box(std::min(std::min(p1.x(), p2.x()), p3.x()), std::min(std::min(p1.y(), p2.y()), p3.y()),
+            std::min(std::min(p1.z(), p2.z()), p3.z()), std::max(std::max(p1.x(), p2.x()), p3.x()),
+            std::max(std::max(p1.y(), p2.y()), p3.y()), std::max(std::max(p1.z(), p2.z()), p3.z()));
+    return ret.overlap(box);
 }
 
 std::string Triangle::to_string() const {
@@ -0,0 +1,450 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/triangle_mesh.h"
+#include "mmgl/surface/triangle.h"
+#include "mmgl/util/simd.h"
+
+namespace mmgl {
+
+/**
+ * Portable kernel, tests the lanes one after another. The sums are formed in the same order as in the
+ * SIMD kernels, so all of them find the same hits.
+ */
+static unsigned triangle_intersect_scalar(const float *tri, int stride, const float *orig, const float *dir,
+                                          float t_max, float *t_num, float *det, float *u_num, float *v_num) {
+    unsigned mask = 0;
+    for (int lane = 0; lane < TRIANGLE_BATCH; ++lane) {
+        const float *v = tri + lane;
+        float e1x = v[3 * stride], e1y = v[4 * stride], e1z = v[5 * stride];
+        float e2x = v[6 * stride], e2y = v[7 * stride], e2z = v[8 * stride];
+        float px = dir[1] * e2z - dir[2] * e2y;
+        float py = dir[2] * e2x - dir[0] * e2z;
+        float pz = dir[0] * e2y - dir[1] * e2x;
+        float d = e1x * px + e1y * py + e1z * pz;
+        float sx = orig[0] - v[0], sy = orig[1] - v[stride], sz = orig[2] - v[2 * stride];
+        float u = sx * px + sy * py + sz * pz;
+        float qx = sy * e1z - sz * e1y;
+        float qy = sz * e1x - sx * e1z;
+        float qz = sx * e1y - sy * e1x;
+        float w = dir[0] * qx + dir[1] * qy + dir[2] * qz;
+        float t = e2x * qx + e2y * qy + e2z * qz;
+        if (d < 0) {
+            d = -d, u = -u, w = -w, t = -t;
+        }
+        t_num[lane] = t;
+        det[lane] = d;
+        u_num[lane] = u;
+        v_num[lane] = w;
+        if (d > 0 && u >= 0 && w >= 0 && u + w <= d && t >= TRIANGLE_T_MIN * d && t < t_max * d) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+}
+
+#ifdef MMGL_X86_SIMD
+
+/**
+ * Test 4 lanes starting at tri, rows of the SoA layout are stride floats apart.
+ * The sign of the determinant is moved onto the other terms, so all tests compare against |det|.
+ */
+static inline unsigned sse_triangles(const float *tri, int stride, const float *orig, const float *dir,
+                                     float t_max, float *t_num, float *det, float *u_num, float *v_num) {
+    __m128 dx = _mm_set1_ps(dir[0]), dy = _mm_set1_ps(dir[1]), dz = _mm_set1_ps(dir[2]);
+    __m128 e1x = _mm_loadu_ps(tri + 3 * stride), e1y = _mm_loadu_ps(tri + 4 * stride);
+    __m128 e1z = _mm_loadu_ps(tri + 5 * stride), e2x = _mm_loadu_ps(tri + 6 * stride);
+    __m128 e2y = _mm_loadu_ps(tri + 7 * stride), e2z = _mm_loadu_ps(tri + 8 * stride);
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(orig[0]), _mm_loadu_ps(tri));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(orig[1]), _mm_loadu_ps(tri + stride));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(orig[2]), _mm_loadu_ps(tri + 2 * stride));
+    __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz));
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+    __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz));
+
+    __m128 sign = _mm_and_ps(d, _mm_set1_ps(-.0f));
+    d = _mm_xor_ps(d, sign), u = _mm_xor_ps(u, sign), w = _mm_xor_ps(w, sign), t = _mm_xor_ps(t, sign);
+    _mm_storeu_ps(t_num, t);
+    _mm_storeu_ps(det, d);
+    _mm_storeu_ps(u_num, u);
+    _mm_storeu_ps(v_num, w);
+    __m128 zero = _mm_setzero_ps();
+    __m128 hit = _mm_and_ps(_mm_cmpgt_ps(d, zero), _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(w, zero)));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, w), d));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(t, _mm_mul_ps(_mm_set1_ps(TRIANGLE_T_MIN), d)));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_mul_ps(_mm_set1_ps(t_max), d)));
+    return static_cast<unsigned>(_mm_movemask_ps(hit));
+}
+
+static unsigned triangle_intersect_sse8(const float *tri, int stride, const float *orig, const float *dir,
+                                        float t_max, float *t_num, float *det, float *u_num, float *v_num) {
+    return sse_triangles(tri, stride, orig, dir, t_max, t_num, det, u_num, v_num) |
+           (sse_triangles(tri + 4, stride, orig, dir, t_max, t_num + 4, det + 4, u_num + 4, v_num + 4) << 4);
+}
+
+__attribute__((target("avx2")))
+static unsigned triangle_intersect_avx8(const float *tri, int stride, const float *orig, const float *dir,
+                                        float t_max, float *t_num, float *det, float *u_num, float *v_num) {
+    __m256 dx = _mm256_set1_ps(dir[0]), dy = _mm256_set1_ps(dir[1]), dz = _mm256_set1_ps(dir[2]);
+    __m256 e1x = _mm256_loadu_ps(tri + 3 * stride), e1y = _mm256_loadu_ps(tri + 4 * stride);
+    __m256 e1z = _mm256_loadu_ps(tri + 5 * stride), e2x = _mm256_loadu_ps(tri + 6 * stride);
+    __m256 e2y = _mm256_loadu_ps(tri + 7 * stride), e2z = _mm256_loadu_ps(tri + 8 * stride);
+    __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                             _mm256_mul_ps(e1z, pz));
+    __m256 sx = _mm256_sub_ps(_mm256_set1_ps(orig[0]), _mm256_loadu_ps(tri));
+    __m256 sy = _mm256_sub_ps(_mm256_set1_ps(orig[1]), _mm256_loadu_ps(tri + stride));
+    __m256 sz = _mm256_sub_ps(_mm256_set1_ps(orig[2]), _mm256_loadu_ps(tri + 2 * stride));
+    __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)),
+                             _mm256_mul_ps(sz, pz));
+    __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+    __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                             _mm256_mul_ps(dz, qz));
+    __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+                             _mm256_mul_ps(e2z, qz));
+
+    __m256 sign = _mm256_and_ps(d, _mm256_set1_ps(-.0f));
+    d = _mm256_xor_ps(d, sign), u = _mm256_xor_ps(u, sign), w = _mm256_xor_ps(w, sign), t = _mm256_xor_ps(t, sign);
+    _mm256_storeu_ps(t_num, t);
+    _mm256_storeu_ps(det, d);
+    _mm256_storeu_ps(u_num, u);
+    _mm256_storeu_ps(v_num, w);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GT_OQ),
+                               _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(w, zero, _CMP_GE_OQ)));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, w), d, _CMP_LE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_mul_ps(_mm256_set1_ps(TRIANGLE_T_MIN), d), _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_mul_ps(_mm256_set1_ps(t_max), d), _CMP_LT_OQ));
+    return static_cast<unsigned>(_mm256_movemask_ps(hit));
+}
+
+#endif
+
+/**
+ * The widest kernel the CPU runs.
+ */
+static TriangleKernel triangle_kernel() {
+#ifdef MMGL_X86_SIMD
+    SimdLevel level = simd_level();
+    if (level == SimdLevel::AVX2) {
+        return &triangle_intersect_avx8;
+    } else if (level == SimdLevel::SSE) {
+        return &triangle_intersect_sse8;
+    }
+#endif
+    return &triangle_intersect_scalar;
+}
+
+TriangleMesh::TriangleMesh(std::vector<float> &&xs, std::vector<float> &&ys, std::vector<float> &&zs,
+                           std::vector<uint32_t> &&indices)
+        : _xs{std::move(xs)}, _ys{std::move(ys)}, _zs{std::move(zs)}, _indices{std::move(indices)},
+          _edges{}, _stride{0} {
+    if (_indices.empty() || _indices.size() % 3 != 0) {
+        throw RenderException("A triangle mesh needs three vertex indices per triangle");
+    }
+    if (_xs.size() != _ys.size() || _xs.size() != _zs.size()) {
+        throw RenderException("A triangle mesh needs all three coordinates of every vertex");
+    }
+
+    float lo[3] = {_xs[_indices[0]], _ys[_indices[0]], _zs[_indices[0]]};
+    float hi[3] = {lo[0], lo[1], lo[2]};
+    for (uint32_t v : _indices) {
+        if (v >= _xs.size()) {
+            throw RenderException("Vertex index " + std::to_string(v) + " of a triangle mesh is out of range");
+        }
+        lo[0] = std::min(lo[0], _xs[v]), hi[0] = std::max(hi[0], _xs[v]);
+        lo[1] = std::min(lo[1], _ys[v]), hi[1] = std::max(hi[1], _ys[v]);
+        lo[2] = std::min(lo[2], _zs[v]), hi[2] = std::max(hi[2], _zs[v]);
+    }
+    box(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+    init_edges();
+}
+
+void TriangleMesh::init_edges() {
+    uint32_t n = prim_num();
+    _stride = (n + TRIANGLE_BATCH - 1) / TRIANGLE_BATCH * TRIANGLE_BATCH;
+    // a batch starting in the last lanes of a row runs over into the next one, or into the tail padding
+    _edges.assign(9 * _stride + TRIANGLE_BATCH, .0f);
+    float *row[9];
+    for (int r = 0; r < 9; ++r) {
+        row[r] = &_edges[r * _stride];
+    }
+    for (uint32_t triangle = 0; triangle < n; ++triangle) {
+        const uint32_t *v = &_indices[3 * triangle];
+        row[0][triangle] = _xs[v[0]];
+        row[1][triangle] = _ys[v[0]];
+        row[2][triangle] = _zs[v[0]];
+        row[3][triangle] = _xs[v[1]] - _xs[v[0]];
+        row[4][triangle] = _ys[v[1]] - _ys[v[0]];
+        row[5][triangle] = _zs[v[1]] - _zs[v[0]];
+        row[6][triangle] = _xs[v[2]] - _xs[v[0]];
+        row[7][triangle] = _ys[v[2]] - _ys[v[0]];
+        row[8][triangle] = _zs[v[2]] - _zs[v[0]];
+    }
+}
+
+bool TriangleMesh::intersect(Ray &ray, const Render &flag) const {
+    if (!box_intersect(ray, true).first) {
+        return false;
+    }
+    if (box_only(flag)) {
+        bool hit = false;
+        for (uint32_t triangle = 0; triangle < prim_num(); ++triangle) {
+            hit = box_hit(ray, triangle) || hit;
+        }
+        return hit;
+    }
+    return nearest_hit(ray, nullptr, 0, prim_num());
+}
+
+bool TriangleMesh::intersect_batch(Ray &ray, const Render &flag, const uint32_t *triangles, uint32_t count) const {
+    return box_only(flag) ? intersect_batch<Render::BBOX_ONLY>(ray, triangles, count)
+                          : intersect_batch<Render::NORMAL>(ray, triangles, count);
+}
+
+template<Render R>
+bool TriangleMesh::intersect_batch(Ray &ray, const uint32_t *triangles, uint32_t count) const {
+    if (box_only<R>()) {
+        bool hit = false;
+        for (uint32_t i = 0; i < count; ++i) {
+            hit = box_hit(ray, triangles[i]) || hit;
+        }
+        return hit;
+    }
+    return nearest_hit(ray, triangles, 0, count);
+}
+
+bool TriangleMesh::nearest_hit(Ray &ray, const uint32_t *triangles, uint32_t first, uint32_t count) const {
+    static const TriangleKernel kernel = triangle_kernel();
+    if (RenderStats *stats = ray.stats()) {
+        stats->triangle_tests += count;
+    }
+
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float dir[3] = {ray.dir().x(), ray.dir().y(), ray.dir().z()};
+    const float t_max = ray.has_intersect() ? ray.hit().t : std::numeric_limits<float>::infinity();
+    const bool skip = ray.start_id() == this;
+
+    float gathered[9 * TRIANGLE_BATCH] = {};
+    float t_num[TRIANGLE_BATCH], det[TRIANGLE_BATCH], u_num[TRIANGLE_BATCH], v_num[TRIANGLE_BATCH];
+    uint32_t best = UINT32_MAX;
+    float best_num = 0, best_det = 1, best_u = 0, best_v = 0;
+    for (uint32_t k = 0; k < count; k += TRIANGLE_BATCH) {
+        uint32_t n = std::min<uint32_t>(TRIANGLE_BATCH, count - k);
+        int stride;
+        const float *tri = batch(triangles, first + k, n, gathered, stride);
+        unsigned mask = kernel(tri, stride, orig, dir, t_max, t_num, det, u_num, v_num) & ((1u << n) - 1);
+        for (uint32_t lane = 0; mask; ++lane, mask >>= 1) {
+            uint32_t triangle = triangles ? triangles[k + first + lane] : first + k + lane;
+            if (!(mask & 1u) || (skip && triangle == ray.start_prim())) {
+                // a shadow or reflection ray never hits the triangle it leaves
+                continue;
+            }
+            // compare t_num / det of two hits without dividing, both determinants are positive
+            if (best == UINT32_MAX || t_num[lane] * best_det < best_num * det[lane]) {
+                best = triangle;
+                best_num = t_num[lane];
+                best_det = det[lane];
+                best_u = u_num[lane];
+                best_v = v_num[lane];
+            }
+        }
+    }
+    if (best == UINT32_MAX) {
+        return false;
+    }
+
+    float t = best_num / best_det;
+    if (ray.updatable(t)) {
+        ray.hit(Hit{t, this, best, best_u / best_det, best_v / best_det});
+    }
+    return true;
+}
+
+bool TriangleMesh::intersect(Ray &ray, const Render &flag, uint32_t triangle) const {
+    return box_only(flag) ? box_hit(ray, triangle) : intersect<Render::NORMAL>(ray, triangle);
+}
+
+bool TriangleMesh::box_hit(Ray &ray, uint32_t triangle) const {
+    if (ray.starts_on(this, triangle)) {
+        // a shadow or reflection ray never hits the triangle it leaves
+        return false;
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->triangle_tests++;
+    }
+    std::pair<bool, float> box_hit = prim_box(triangle).intersect(ray, false);
+    if (!box_hit.first) {
+        return false;
+    }
+    if (ray.updatable(box_hit.second)) {
+        ray.hit(Hit{box_hit.second, this, triangle, 0, 0});
+    }
+    return true;
+}
+
+bool TriangleMesh::box_blocks(const Ray &ray, uint32_t triangle, float t_max) const {
+    if (ray.starts_on(this, triangle)) {
+        return false;
+    }
+    if (RenderStats *stats = ray.stats()) {
+        stats->triangle_tests++;
+    }
+    std::pair<bool, float> box_hit = prim_box(triangle).intersect(ray, false);
+    return box_hit.first && box_hit.second > EPS && box_hit.second < t_max;
+}
+
+template<Render R>
+bool TriangleMesh::intersect(Ray &ray, uint32_t triangle) const {
+    // a lane of the batch kernel, so a closest hit and an occlusion query never disagree on a triangle
+    return box_only<R>() ? box_hit(ray, triangle) : nearest_hit(ray, nullptr, triangle, 1);
+}
+
+Vector TriangleMesh::normal(const Hit &hit, const Point &) const {
+    // not stored per triangle, the cross product of the two edges
+    Vector e1{_edges[3 * _stride + hit.prim], _edges[4 * _stride + hit.prim], _edges[5 * _stride + hit.prim]};
+    Vector e2{_edges[6 * _stride + hit.prim], _edges[7 * _stride + hit.prim], _edges[8 * _stride + hit.prim]};
+    Vector norm = e1.cross(e2);
+    norm.normalize();
+    return norm;
+}
+
+bool TriangleMesh::occluded(const Ray &ray, const Render &flag, uint32_t triangle, float t_max) const {
+    return box_only(flag) ? box_blocks(ray, triangle, t_max) : any_hit(ray, nullptr, triangle, 1, t_max);
+}
+
+bool TriangleMesh::occluded_batch(const Ray &ray, const Render &flag, const uint32_t *triangles, uint32_t count,
+                                  float t_max) const {
+    return box_only(flag) ? occluded_batch<Render::BBOX_ONLY>(ray, triangles, count, t_max)
+                          : occluded_batch<Render::NORMAL>(ray, triangles, count, t_max);
+}
+
+template<Render R>
+bool TriangleMesh::occluded_batch(const Ray &ray, const uint32_t *triangles, uint32_t count, float t_max) const {
+    if (box_only<R>()) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (box_blocks(ray, triangles[i], t_max)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return any_hit(ray, triangles, 0, count, t_max);
+}
+
+template bool TriangleMesh::intersect<Render::NORMAL>(Ray &, uint32_t) const;
+template bool TriangleMesh::intersect<Render::BBOX_ONLY>(Ray &, uint32_t) const;
+template bool TriangleMesh::intersect<Render::BVH_BBOX_ONLY>(Ray &, uint32_t) const;
+template bool TriangleMesh::intersect<Render::BVH>(Ray &, uint32_t) const;
+template bool TriangleMesh::intersect_batch<Render::NORMAL>(Ray &, const uint32_t *, uint32_t) const;
+template bool TriangleMesh::intersect_batch<Render::BBOX_ONLY>(Ray &, const uint32_t *, uint32_t) const;
+template bool TriangleMesh::intersect_batch<Render::BVH_BBOX_ONLY>(Ray &, const uint32_t *, uint32_t) const;
+template bool TriangleMesh::intersect_batch<Render::BVH>(Ray &, const uint32_t *, uint32_t) const;
+template bool TriangleMesh::occluded_batch<Render::NORMAL>(const Ray &, const uint32_t *, uint32_t, float) const;
+template bool TriangleMesh::occluded_batch<Render::BBOX_ONLY>(const Ray &, const uint32_t *, uint32_t, float) const;
+template bool TriangleMesh::occluded_batch<Render::BVH_BBOX_ONLY>(const Ray &, const uint32_t *, uint32_t,
+                                                                  float) const;
+template bool TriangleMesh::occluded_batch<Render::BVH>(const Ray &, const uint32_t *, uint32_t, float) const;
+
+bool TriangleMesh::any_hit(const Ray &ray, const uint32_t *triangles, uint32_t first, uint32_t count,
+                           float t_max) const {
+    static const TriangleKernel kernel = triangle_kernel();
+    if (RenderStats *stats = ray.stats()) {
+        stats->triangle_tests += count;
+    }
+
+    const float orig[3] = {ray.origin().x(), ray.origin().y(), ray.origin().z()};
+    const float dir[3] = {ray.dir().x(), ray.dir().y(), ray.dir().z()};
+    const bool skip = ray.start_id() == this;
+
+    float gathered[9 * TRIANGLE_BATCH] = {};
+    float t_num[TRIANGLE_BATCH], det[TRIANGLE_BATCH], u_num[TRIANGLE_BATCH], v_num[TRIANGLE_BATCH];
+    for (uint32_t k = 0; k < count; k += TRIANGLE_BATCH) {
+        uint32_t n = std::min<uint32_t>(TRIANGLE_BATCH, count - k);
+        int stride;
+        const float *tri = batch(triangles, first + k, n, gathered, stride);
+        unsigned mask = kernel(tri, stride, orig, dir, t_max, t_num, det, u_num, v_num) & ((1u << n) - 1);
+        for (uint32_t lane = 0; mask; ++lane, mask >>= 1) {
+            uint32_t triangle = triangles ? triangles[first + k + lane] : first + k + lane;
+            // the division is only done for candidates, to drop hits closer than EPS like the closest-hit query
+            if ((mask & 1u) && !(skip && triangle == ray.start_prim()) && t_num[lane] / det[lane] > EPS) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+const float *TriangleMesh::batch(const uint32_t *triangles, uint32_t k, uint32_t n, float *gathered,
+                                 int &stride) const {
+    uint32_t start = triangles ? triangles[k] : k;
+    bool contiguous = true;
+    for (uint32_t lane = 1; triangles && lane < n; ++lane) {
+        contiguous = contiguous && triangles[k + lane] == start + lane;
+    }
+    if (contiguous) {
+        stride = static_cast<int>(_stride);
+        return &_edges[start];
+    }
+    for (int r = 0; r < 9; ++r) {
+        for (uint32_t lane = 0; lane < n; ++lane) {
+            gathered[r * TRIANGLE_BATCH + lane] = _edges[r * _stride + triangles[k + lane]];
+        }
+    }
+    stride = TRIANGLE_BATCH;
+    return gathered;
+}
+
+BBox TriangleMesh::prim_box(uint32_t triangle) const {
+    const uint32_t *v = &_indices[3 * triangle];
+    BBox box;
+    box.box(std::min(std::min(_xs[v[0]], _xs[v[1]]), _xs[v[2]]),
+            std::min(std::min(_ys[v[0]], _ys[v[1]]), _ys[v[2]]),
+            std::min(std::min(_zs[v[0]], _zs[v[1]]), _zs[v[2]]),
+            std::max(std::max(_xs[v[0]], _xs[v[1]]), _xs[v[2]]),
+            std::max(std::max(_ys[v[0]], _ys[v[1]]), _ys[v[2]]),
+            std::max(std::max(_zs[v[0]], _zs[v[1]]), _zs[v[2]]));
+    return box;
+}
+
+BBox TriangleMesh::prim_clip(uint32_t triangle, const BBox &bounds) const {
+    return clip_triangle(vertex(triangle, 0), vertex(triangle, 1), vertex(triangle, 2), bounds);
+}
+
+void TriangleMesh::reorder(const std::vector<uint32_t> &order) {
+    std::vector<uint32_t> indices;
+    indices.reserve(_indices.size());
+    for (uint32_t triangle : order) {
+        indices.insert(indices.end(), &_indices[3 * triangle], &_indices[3 * triangle] + 3);
+    }
+    _indices.swap(indices);
+    init_edges();
+}
+
+std::string TriangleMesh::to_string() const {
+    std::stringstream os;
+    os << "TriangleMesh:\n";
+    os << "\tvertices: " << _xs.size() << "\n";
+    os << "\ttriangles: " << prim_num() << std::flush;
+    return os.str();
+}
+
+TriangleMesh &TriangleMesh::made_of(const Material &material) {
+    Surface::material(material);
+    return *this;
+}
+
+}
@@ -0,0 +1,218 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/surface/wide_bvh.h"
+#include "mmgl/util/simd.h"
+
+namespace mmgl {
+
+/**
+ * Portable kernel, tests the lanes one after another.
+ */
+template<int N>
+static unsigned wide_intersect_scalar(const float *bounds, const float *orig, const float *inv_dir,
+                                      float t_max, float *t_near) {
+    unsigned mask = 0;
+    for (int lane = 0; lane < N; ++lane) {
+        float t_in = -std::numeric_limits<float>::infinity();
+        float t_out = t_max;
+        for (int axis = 0; axis < 3; ++axis) {
+            float t0 = (bounds[axis * N + lane] - orig[axis]) * inv_dir[axis];
+            float t1 = (bounds[(axis + 3) * N + lane] - orig[axis]) * inv_dir[axis];
+            t_in = std::max(t_in, std::min(t0, t1));
+            t_out = std::min(t_out, std::max(t0, t1));
+        }
+        t_near[lane] = t_in;
+        if (t_in <= t_out && t_out >= .0f) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+}
+
+#ifdef MMGL_X86_SIMD
+
+/**
+ * Test 4 lanes starting at bounds, rows of the SoA layout are stride floats apart.
+ * The running t_in/t_out are the second operands of min/max, so a NaN lane result is dropped.
+ */
+static inline unsigned sse_intersect(const float *bounds, int stride, const float *orig, const float *inv_dir,
+                                     float t_max, float *t_near) {
+    __m128 t_in = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    __m128 t_out = _mm_set1_ps(t_max);
+    for (int axis = 0; axis < 3; ++axis) {
+        __m128 o = _mm_set1_ps(orig[axis]);
+        __m128 inv = _mm_set1_ps(inv_dir[axis]);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds + axis * stride), o), inv);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds + (axis + 3) * stride), o), inv);
+        t_in = _mm_max_ps(_mm_min_ps(t0, t1), t_in);
+        t_out = _mm_min_ps(_mm_max_ps(t0, t1), t_out);
+    }
+    _mm_storeu_ps(t_near, t_in);
+    __m128 hit = _mm_and_ps(_mm_cmple_ps(t_in, t_out), _mm_cmpge_ps(t_out, _mm_setzero_ps()));
+    return static_cast<unsigned>(_mm_movemask_ps(hit));
+}
+
+static unsigned wide_intersect_sse4(const float *bounds, const float *orig, const float *inv_dir,
+                                    float t_max, float *t_near) {
+    return sse_intersect(bounds, 4, orig, inv_dir, t_max, t_near);
+}
+
+static unsigned wide_intersect_sse8(const float *bounds, const float *orig, const float *inv_dir,
+                                    float t_max, float *t_near) {
+    return sse_intersect(bounds, 8, orig, inv_dir, t_max, t_near) |
+           (sse_intersect(bounds + 4, 8, orig, inv_dir, t_max, t_near + 4) << 4);
+}
+
+__attribute__((target("avx2")))
+static unsigned wide_intersect_avx8(const float *bounds, const float *orig, const float *inv_dir,
+                                    float t_max, float *t_near) {
+    __m256 t_in = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256 t_out = _mm256_set1_ps(t_max);
+    for (int axis = 0; axis < 3; ++axis) {
+        __m256 o = _mm256_set1_ps(orig[axis]);
+        __m256 inv = _mm256_set1_ps(inv_dir[axis]);
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds + axis * 8), o), inv);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds + (axis + 3) * 8), o), inv);
+        t_in = _mm256_max_ps(_mm256_min_ps(t0, t1), t_in);
+        t_out = _mm256_min_ps(_mm256_max_ps(t0, t1), t_out);
+    }
+    _mm256_storeu_ps(t_near, t_in);
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(t_in, t_out, _CMP_LE_OQ),
+                               _mm256_cmp_ps(t_out, _mm256_setzero_ps(), _CMP_GE_OQ));
+    return static_cast<unsigned>(_mm256_movemask_ps(hit));
+}
+
+#endif
+
+/**
+ * Surface area of a binary node, the child with the largest one is opened up first while collapsing.
+ */
+static inline float node_area(const LinearBVHNode &node) {
+    float dx = node.max[0] - node.min[0], dy = node.max[1] - node.min[1], dz = node.max[2] - node.min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+void WideBVH::build(const LinearBVH &bvh, unsigned width) {
+    clear();
+    if (width != 4 && width != 8) {
+        throw RenderException("Wide BVH supports a width of 4 or 8 only");
+    }
+    _width = width;
+    if (bvh.empty()) {
+        return;
+    }
+
+    _order = bvh.order();
+    _lane_of.assign(bvh.nodes().size(), UINT32_MAX);
+    if (_width == 4) {
+        _nodes4.reserve(bvh.nodes().size() / 2 + 1);
+        collapse(bvh, 0, _nodes4);
+    } else {
+        _nodes8.reserve(bvh.nodes().size() / 4 + 1);
+        collapse(bvh, 0, _nodes8);
+    }
+
+    SimdLevel level = simd_level();
+    if (level == SimdLevel::SCALAR) {
+        _kernel = _width == 4 ? &wide_intersect_scalar<4> : &wide_intersect_scalar<8>;
+    }
+#ifdef MMGL_X86_SIMD
+    else if (_width == 4) {
+        _kernel = &wide_intersect_sse4;
+    } else {
+        _kernel = level == SimdLevel::AVX2 ? &wide_intersect_avx8 : &wide_intersect_sse8;
+    }
+#endif
+}
+
+void WideBVH::clear() {
+    _nodes4.clear();
+    _nodes8.clear();
+    _order.clear();
+    _lane_of.clear();
+    _kernel = nullptr;
+}
+
+void WideBVH::refit(const LinearBVH &bvh, const std::vector<uint32_t> &updated) {
+    if (_width == 4) {
+        refit(bvh, updated, _nodes4);
+    } else {
+        refit(bvh, updated, _nodes8);
+    }
+}
+
+template<int N>
+void WideBVH::refit(const LinearBVH &bvh, const std::vector<uint32_t> &updated, std::vector<WideBVHNode<N>> &nodes) {
+    const std::vector<LinearBVHNode> &binary = bvh.nodes();
+    for (uint32_t index : updated) {
+        uint32_t slot = _lane_of[index];
+        if (slot == UINT32_MAX) {
+            continue;
+        }
+        WideBVHNode<N> &node = nodes[slot / 8];
+        for (int axis = 0; axis < 3; ++axis) {
+            node.bounds[axis][slot % 8] = binary[index].min[axis];
+            node.bounds[axis + 3][slot % 8] = binary[index].max[axis];
+        }
+    }
+}
+
+template<int N>
+uint32_t WideBVH::collapse(const LinearBVH &bvh, uint32_t index, std::vector<WideBVHNode<N>> &nodes) {
+    const std::vector<LinearBVHNode> &binary = bvh.nodes();
+    uint32_t wide_index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    uint32_t children[N];
+    int child_num = 0;
+    if (binary[index].prim_num > 0) {
+        // only a single leaf at the root
+        children[child_num++] = index;
+    } else {
+        children[child_num++] = index + 1;
+        children[child_num++] = binary[index].offset;
+    }
+
+    // open up the interior child with the largest surface area until the node is full
+    while (child_num < N) {
+        int best = -1;
+        float best_area = -1.0f;
+        for (int k = 0; k < child_num; ++k) {
+            const LinearBVHNode &child = binary[children[k]];
+            if (child.prim_num == 0 && node_area(child) > best_area) {
+                best = k;
+                best_area = node_area(child);
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        uint32_t opened = children[best];
+        children[best] = opened + 1;
+        children[child_num++] = binary[opened].offset;
+    }
+
+    WideBVHNode<N> node{};
+    for (int lane = 0; lane < child_num; ++lane) {
+        const LinearBVHNode &child = binary[children[lane]];
+        _lane_of[children[lane]] = wide_index * 8 + lane;
+        for (int axis = 0; axis < 3; ++axis) {
+            node.bounds[axis][lane] = child.min[axis];
+            node.bounds[axis + 3][lane] = child.max[axis];
+        }
+        if (child.prim_num > 0) {
+            node.child[lane] = child.offset;
+            node.count[lane] = child.prim_num;
+        } else {
+            node.child[lane] = collapse(bvh, children[lane], nodes);
+        }
+    }
+    node.valid = (1u << child_num) - 1;
+    nodes[wide_index] = node;
+    return wide_index;
+}
+
+}
@@ -48,11 +48,13 @@ float get_token_as_float(std::string inString, int whichToken) {
 }
 
 
-void parse_obj_file(const std::string &file, std::vector<int> &tris, std::vector<float> &verts) {
-    // clear out the tris and verts vectors:
-    tris.clear();
-    verts.clear();
+namespace {
 
+/**
+ * Read the vertices and faces of an OBJ file, calling vertex(x, y, z) and face(i, j, k) with 0-based indices.
+ */
+template<typename VertexFunction, typename FaceFunction>
+void read_obj_file(const std::string &file, VertexFunction vertex, FaceFunction face) {
     std::ifstream in(file.c_str());
 
     if (!in.good()) {
@@ -83,9 +85,7 @@ void parse_obj_file(const std::string &file, std::vector<int> &tris, std::vector
             float pa, pb, pc;
             iss >> pa >> pb >> pc;
 
-            verts.push_back(pa);
-            verts.push_back(pb);
-            verts.push_back(pc);
+            vertex(pa, pb, pc);
         }
         else if (cmd == "f") {
             // got a face (triangle)
@@ -97,9 +97,7 @@ void parse_obj_file(const std::string &file, std::vector<int> &tris, std::vector
             // vertex numbers in OBJ files start with 1, but in C++ array
             // indices start with 0, so we're shifting everything down by
             // 1
-            tris.push_back(i - 1);
-            tris.push_back(j - 1);
-            tris.push_back(k - 1);
+            face(i - 1, j - 1, k - 1);
         }
         else {
             throw FileException("Invalid command at line: " + std::to_string(line));
@@ -110,6 +108,45 @@ void parse_obj_file(const std::string &file, std::vector<int> &tris, std::vector
     in.close();
 }
 
+}
+
+void parse_obj_file(const std::string &file, std::vector<int> &tris, std::vector<float> &verts) {
+    // clear out the tris and verts vectors:
+    tris.clear();
+    verts.clear();
+
+    read_obj_file(file, [&](float x, float y, float z) {
+        verts.push_back(x);
+        verts.push_back(y);
+        verts.push_back(z);
+    }, [&](int i, int j, int k) {
+        tris.push_back(i);
+        tris.push_back(j);
+        tris.push_back(k);
+    });
+}
+
+void parse_obj_file(const std::string &file, std::vector<uint32_t> &indices,
+                    std::vector<float> &xs, std::vector<float> &ys, std::vector<float> &zs) {
+    indices.clear();
+    xs.clear();
+    ys.clear();
+    zs.clear();
+
+    read_obj_file(file, [&](float x, float y, float z) {
+        xs.push_back(x);
+        ys.push_back(y);
+        zs.push_back(z);
+    }, [&](int i, int j, int k) {
+        if (i < 0 || j < 0 || k < 0) {
+            throw FileException("Invalid vertex index in file: " + file);
+        }
+        indices.push_back(static_cast<uint32_t>(i));
+        indices.push_back(static_cast<uint32_t>(j));
+        indices.push_back(static_cast<uint32_t>(k));
+    });
+}
+
 // float rand_float() {
 //     return static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX);
 // }
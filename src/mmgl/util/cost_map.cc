@@ -0,0 +1,53 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include <algorithm>
+
+#include "mmgl/util/cost_map.h"
+
+namespace mmgl {
+
+void CostMap::reset(int width, int height) {
+    _width = width;
+    _height = height;
+    _blocks.assign(static_cast<size_t>(width) * height, .0f);
+    _tasks.clear();
+}
+
+float CostMap::total() const {
+    double sum = 0;
+    for (float ms : _blocks) {
+        sum += ms;
+    }
+    return static_cast<float>(sum);
+}
+
+float CostMap::imbalance() const {
+    if (_tasks.empty()) {
+        return 1.0f;
+    }
+    double sum = 0;
+    for (float ms : _tasks) {
+        sum += ms;
+    }
+    float max = *std::max_element(_tasks.begin(), _tasks.end());
+    return sum > 0 ? static_cast<float>(max / (sum / _tasks.size())) : 1.0f;
+}
+
+std::ostream &operator<<(std::ostream &os, const CostMap &costs) {
+    float max = 0;
+    for (int y = 0; y < costs.height(); ++y) {
+        for (int x = 0; x < costs.width(); ++x) {
+            max = std::max(max, costs.block(x, y));
+        }
+    }
+    float blocks = static_cast<float>(costs.width()) * costs.height();
+    os << "Costs: " << costs.total() << " ms in " << costs.width() << "x" << costs.height() << " blocks, "
+       << (blocks > 0 ? costs.total() / blocks : .0f) << " ms avg / " << max << " ms max, "
+       << costs.tasks().size() << " tasks, imbalance " << costs.imbalance() << std::flush;
+    return os;
+}
+
+}
@@ -0,0 +1,27 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/util/simd.h"
+
+namespace mmgl {
+
+static SimdLevel detect_simd_level() {
+#ifdef MMGL_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+SimdLevel simd_level() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+}
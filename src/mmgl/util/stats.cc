@@ -0,0 +1,55 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/util/stats.h"
+
+namespace mmgl {
+
+void RenderStats::merge(const RenderStats &other) {
+    box_tests += other.box_tests;
+    triangle_tests += other.triangle_tests;
+    sphere_tests += other.sphere_tests;
+    node_visits += other.node_visits;
+    primary_rays += other.primary_rays;
+    primary_packets += other.primary_packets;
+    primary_nodes += other.primary_nodes;
+    reflection_rays += other.reflection_rays;
+    reflection_nodes += other.reflection_nodes;
+    shadow_rays += other.shadow_rays;
+    shadow_nodes += other.shadow_nodes;
+}
+
+std::ostream &operator<<(std::ostream &os, const BVHStats &stats) {
+    os << "BVH: " << stats.node_num << " nodes, " << stats.leaf_num << " leaves, "
+       << stats.reference_num << " references";
+    if (stats.wide_node_num) {
+        os << ", " << stats.wide_node_num << " wide nodes";
+    }
+    os << ", depth " << stats.max_depth << " max / " << stats.avg_depth << " avg, SAH cost " << stats.sah_cost
+       << ", " << stats.memory / 1024 << " KB" << std::flush;
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const RenderStats &stats) {
+    auto per_ray = [](uint64_t nodes, uint64_t rays) {
+        return rays ? static_cast<double>(nodes) / rays : .0;
+    };
+    os << "Render: " << stats.box_tests << " box tests, " << stats.triangle_tests << " triangle tests, "
+       << stats.sphere_tests << " sphere tests\n";
+    os << "\t" << stats.primary_rays << " primary rays, " << per_ray(stats.primary_nodes, stats.primary_rays)
+       << " nodes per ray";
+    if (stats.primary_packets) {
+        os << " in " << stats.primary_packets << " packets, "
+           << per_ray(stats.primary_nodes, stats.primary_packets) << " nodes per packet";
+    }
+    os << "\n";
+    os << "\t" << stats.reflection_rays << " reflection rays, "
+       << per_ray(stats.reflection_nodes, stats.reflection_rays) << " nodes per ray\n";
+    os << "\t" << stats.shadow_rays << " shadow rays, " << per_ray(stats.shadow_nodes, stats.shadow_rays)
+       << " nodes per ray" << std::flush;
+    return os;
+}
+
+}
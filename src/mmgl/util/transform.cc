@@ -0,0 +1,115 @@
+//
+// Final Project for COMS 4998: C++ Library Design
+// Author: He Li(hl2918), Haoxiang Xu(hx2185), Wangda Zhang(zwd)
+//
+
+#include "mmgl/util/transform.h"
+
+namespace mmgl {
+
+Transform::Transform() : _m{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}} { }
+
+Transform &Transform::translate(float x, float y, float z) {
+    Transform step;
+    step._m[0][3] = x;
+    step._m[1][3] = y;
+    step._m[2][3] = z;
+    return *this = step * *this;
+}
+
+Transform &Transform::scale(float x, float y, float z) {
+    Transform step;
+    step._m[0][0] = x;
+    step._m[1][1] = y;
+    step._m[2][2] = z;
+    return *this = step * *this;
+}
+
+Transform &Transform::rotate(float degrees, float x, float y, float z) {
+    Vector axis{x, y, z};
+    axis.normalize();
+    float radians = degrees * static_cast<float>(M_PI) / 180.0f;
+    float c = cosf(radians), s = sinf(radians), t = 1 - c;
+    x = axis.x(), y = axis.y(), z = axis.z();
+
+    // Rodrigues' rotation formula
+    Transform step;
+    step._m[0][0] = t * x * x + c;
+    step._m[0][1] = t * x * y - s * z;
+    step._m[0][2] = t * x * z + s * y;
+    step._m[1][0] = t * x * y + s * z;
+    step._m[1][1] = t * y * y + c;
+    step._m[1][2] = t * y * z - s * x;
+    step._m[2][0] = t * x * z - s * y;
+    step._m[2][1] = t * y * z + s * x;
+    step._m[2][2] = t * z * z + c;
+    return *this = step * *this;
+}
+
+Transform Transform::operator*(const Transform &rhs) const {
+    Transform ret;
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            ret._m[row][col] = _m[row][0] * rhs._m[0][col] + _m[row][1] * rhs._m[1][col] +
+                               _m[row][2] * rhs._m[2][col] + (col == 3 ? _m[row][3] : .0f);
+        }
+    }
+    return ret;
+}
+
+Transform Transform::inverse() const {
+    // inverse of the linear part from its cofactors
+    float det = _m[0][0] * (_m[1][1] * _m[2][2] - _m[1][2] * _m[2][1]) -
+                _m[0][1] * (_m[1][0] * _m[2][2] - _m[1][2] * _m[2][0]) +
+                _m[0][2] * (_m[1][0] * _m[2][1] - _m[1][1] * _m[2][0]);
+    if (det == .0f) {
+        throw RenderException("Cannot invert a singular transform");
+    }
+    float inv_det = 1.0f / det;
+
+    Transform ret;
+    ret._m[0][0] = (_m[1][1] * _m[2][2] - _m[1][2] * _m[2][1]) * inv_det;
+    ret._m[0][1] = (_m[0][2] * _m[2][1] - _m[0][1] * _m[2][2]) * inv_det;
+    ret._m[0][2] = (_m[0][1] * _m[1][2] - _m[0][2] * _m[1][1]) * inv_det;
+    ret._m[1][0] = (_m[1][2] * _m[2][0] - _m[1][0] * _m[2][2]) * inv_det;
+    ret._m[1][1] = (_m[0][0] * _m[2][2] - _m[0][2] * _m[2][0]) * inv_det;
+    ret._m[1][2] = (_m[0][2] * _m[1][0] - _m[0][0] * _m[1][2]) * inv_det;
+    ret._m[2][0] = (_m[1][0] * _m[2][1] - _m[1][1] * _m[2][0]) * inv_det;
+    ret._m[2][1] = (_m[0][1] * _m[2][0] - _m[0][0] * _m[2][1]) * inv_det;
+    ret._m[2][2] = (_m[0][0] * _m[1][1] - _m[0][1] * _m[1][0]) * inv_det;
+
+    // the translation moves back by the inverse of the linear part
+    for (int row = 0; row < 3; ++row) {
+        ret._m[row][3] = -(ret._m[row][0] * _m[0][3] + ret._m[row][1] * _m[1][3] + ret._m[row][2] * _m[2][3]);
+    }
+    return ret;
+}
+
+Point Transform::apply(const Point &point) const {
+    return Point{_m[0][0] * point.x() + _m[0][1] * point.y() + _m[0][2] * point.z() + _m[0][3],
+                 _m[1][0] * point.x() + _m[1][1] * point.y() + _m[1][2] * point.z() + _m[1][3],
+                 _m[2][0] * point.x() + _m[2][1] * point.y() + _m[2][2] * point.z() + _m[2][3]};
+}
+
+Vector Transform::apply(const Vector &vector) const {
+    return Vector{_m[0][0] * vector.x() + _m[0][1] * vector.y() + _m[0][2] * vector.z(),
+                  _m[1][0] * vector.x() + _m[1][1] * vector.y() + _m[1][2] * vector.z(),
+                  _m[2][0] * vector.x() + _m[2][1] * vector.y() + _m[2][2] * vector.z()};
+}
+
+Vector Transform::apply_transposed(const Vector &vector) const {
+    return Vector{_m[0][0] * vector.x() + _m[1][0] * vector.y() + _m[2][0] * vector.z(),
+                  _m[0][1] * vector.x() + _m[1][1] * vector.y() + _m[2][1] * vector.z(),
+                  _m[0][2] * vector.x() + _m[1][2] * vector.y() + _m[2][2] * vector.z()};
+}
+
+std::ostream &operator<<(std::ostream &os, const Transform &transform) {
+    os << "Transform:\n";
+    for (int row = 0; row < 3; ++row) {
+        os << "\t" << transform(row, 0) << " " << transform(row, 1) << " " << transform(row, 2) << " "
+           << transform(row, 3) << (row < 2 ? "\n" : "");
+    }
+    return os << std::flush;
+}
+
+}